@@ -17,14 +17,11 @@ extern char *argv0;
         for (i_ = 1, argused_ = 0; (*argv)[i_]; i_++) {                           \
             switch ((*argv)[i_]) {
 #define ARGEND \
-                if (argused_) {                                                   \
-                    if ((*argv)[i_ + 1]) {                                        \
-                        break;                                                    \
-                    } else {                                                      \
-                        argc--, argv++;                                           \
-                        break;                                                    \
-                    }                                                             \
-                }                                                                 \
+            }                                                                     \
+            if (argused_) {                                                       \
+                if (!(*argv)[i_ + 1])                                             \
+                    argc--, argv++;                                               \
+                break;                                                            \
             }                                                                     \
         }                                                                         \
     }
@@ -0,0 +1,257 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include "arg.h"
+#include "registry.h"
+#include "slstatus.h"
+#include "util.h"
+
+/*
+ * Microbenchmark for the status functions. Each function is called a number
+ * of times, with the tick advanced in between so that per tick caching does
+ * not hide the cost, and the time, heap allocations and system calls per
+ * call are reported. Linux (glibc) only.
+ */
+
+char buf[1024];
+unsigned int tick;
+unsigned int interval = 1000;
+unsigned int disk_timeout = 500;
+int disk_total_on_mount_change = 0;
+#if HAVE_MPD
+int mpd_title_length = 20;
+char *mpd_loop_text = " ~ ";
+int mpd_on_text_fits = NO_SCROLL;
+#endif
+
+/* arguments for functions that need one when none is given */
+static const struct {
+	const char *name;
+	const char *arg;
+} defaults[] = {
+	{ "datetime",    "%F %T" },
+	{ "datetime_tz", "UTC %F %T" },
+	{ "disk_free",   "/" },
+	{ "disk_perc",   "/" },
+	{ "disk_total",  "/" },
+	{ "disk_used",   "/" },
+	{ "num_files",   "/tmp" },
+	{ "run_command", "true" },
+	{ "run_exec",    "true" },
+};
+
+static unsigned long allocs;
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+void *
+malloc(size_t size)
+{
+	allocs++;
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	allocs++;
+	return __libc_realloc(ptr, size);
+}
+
+static void
+run(const struct function *f, const char *arg, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		++tick;
+		f->func(arg);
+	}
+}
+
+/* Counts the system calls made by n calls of a function, in a traced child
+ * so that threads the function starts are included. The child warms up
+ * first and then stops itself, which is where counting starts. Returns -1
+ * if tracing is not possible (e.g. ptrace is disallowed). */
+static long
+syscalls(const struct function *f, const char *arg, unsigned long n)
+{
+	pid_t pid, w;
+	int status, sig;
+	long count = 0;
+
+	fflush(stdout);
+	if ((pid = fork()) < 0)
+		return -1;
+
+	if (pid == 0) {
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) < 0)
+			_exit(1);
+		raise(SIGSTOP);
+		run(f, arg, 1);
+		raise(SIGSTOP);
+		run(f, arg, n);
+		_exit(0);
+	}
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status))
+		return -1;
+
+	ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(PTRACE_O_TRACESYSGOOD |
+	       PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL));
+	ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+	while ((w = waitpid(-1, &status, __WALL)) > 0) {
+		if (WIFEXITED(status) || WIFSIGNALED(status)) {
+			if (w == pid)
+				break;
+			continue;
+		}
+
+		sig = 0;
+		if (WSTOPSIG(status) == (SIGTRAP | 0x80))
+			count++;
+		else if (WSTOPSIG(status) == SIGSTOP && w == pid)
+			count = 0; /* warmed up */
+		else if (WSTOPSIG(status) != SIGTRAP && WSTOPSIG(status) != SIGSTOP)
+			sig = WSTOPSIG(status);
+
+		ptrace(PTRACE_SYSCALL, w, NULL, (void *)(intptr_t)sig);
+	}
+
+	/* each system call stops on entry and exit */
+	return count / 2;
+}
+
+/* Every function is measured in fresh processes, so that caches, delta state
+ * and helper threads of one run do not leak into the next. */
+static void
+bench(const struct function *f, const char *arg, unsigned long n)
+{
+	struct timespec start, end;
+	unsigned long a;
+	double ns;
+	long sc;
+	pid_t pid;
+
+	sc = syscalls(f, arg, n);
+
+	fflush(stdout);
+	if ((pid = fork()) < 0)
+		die("fork:");
+	if (pid) {
+		waitpid(pid, NULL, 0);
+		return;
+	}
+
+	/* the first call sets up cached descriptors and delta state */
+	run(f, arg, 1);
+
+	a = allocs;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	run(f, arg, n);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	a = allocs - a;
+
+	ns = (end.tv_sec - start.tv_sec) * 1E9 + (end.tv_nsec - start.tv_nsec);
+
+	printf("%-20s %-16s %12.0f %10.2f ", f->name, arg ? arg : "",
+	       ns / n, (double)a / n);
+	if (sc < 0)
+		printf("%10s\n", "-");
+	else
+		printf("%10.2f\n", (double)sc / n);
+	fflush(stdout);
+	_exit(0);
+}
+
+static const char *
+defaultarg(const struct function *f)
+{
+	size_t i;
+
+	for (i = 0; i < LEN(defaults); i++)
+		if (!strcmp(defaults[i].name, f->name))
+			return defaults[i].arg;
+
+	return NULL;
+}
+
+static void
+usage(void)
+{
+	die("usage: %s [-v] [-n iterations] [-r root] [function[=argument] ...]", argv0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const struct function *f;
+	unsigned long n = 1000;
+	int verbose = 0;
+	char *arg;
+	size_t i;
+
+	ARGBEGIN {
+	case 'n':
+		n = strtoul(EARGF(usage()), NULL, 10);
+		break;
+	case 'r':
+		sysroot = EARGF(usage());
+		break;
+	case 'v':
+		verbose = 1;
+		break;
+	default:
+		usage();
+	} ARGEND
+
+	if (!n)
+		usage();
+
+	/* the status functions warn on every failed call */
+	if (!verbose && !freopen("/dev/null", "w", stderr))
+		die("freopen '/dev/null':");
+
+	printf("%-20s %-16s %12s %10s %10s\n", "function", "argument",
+	       "ns/call", "allocs/call", "syscalls/call");
+
+	if (!argc) {
+		for (i = 0; (f = function_at(i)); i++) {
+			arg = (char *)defaultarg(f);
+			if (f->arg != ARG_REQUIRED || arg)
+				bench(f, arg, n);
+		}
+		return 0;
+	}
+
+	for (; argc; argc--, argv++) {
+		if ((arg = strchr(*argv, '=')))
+			*arg++ = '\0';
+		if (!(f = lookup_function(*argv)))
+			die("%s: no function with name %s", argv0, *argv);
+		if (!arg && f->arg == ARG_REQUIRED && !(arg = (char *)defaultarg(f)))
+			die("%s: %s requires an argument", argv0, *argv);
+		bench(f, arg, n);
+	}
+
+	return 0;
+}
@@ -30,6 +30,7 @@
 			return NULL;
 		}
 
+		setnum(cur * 100 / max);
 		return bprintf("%d%%", cur * 100 / max);
 	}
 #elif defined(__OpenBSD__)
@@ -54,6 +55,6 @@
 			warn("ioctl 'WSDISPLAYIO_GETPARAM' failed");
 			return NULL;
 		}
-		return bprintf("%d", wsd_param.curval * 100 / wsd_param.max);
+		return fmt_int(wsd_param.curval * 100 / wsd_param.max);
 	}
 #endif
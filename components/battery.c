@@ -25,11 +25,11 @@
 	     size_t length)
 	{
 		if (esnprintf(path, length, f1, bat) > 0 &&
-		    access(path, R_OK) == 0)
+		    access(rpath(path), R_OK) == 0)
 			return f1;
 
 		if (esnprintf(path, length, f2, bat) > 0 &&
-		    access(path, R_OK) == 0)
+		    access(rpath(path), R_OK) == 0)
 			return f2;
 
 		return NULL;
@@ -46,7 +46,7 @@
 		if (pscanf(path, "%d", &cap_perc) != 1)
 			return NULL;
 
-		return bprintf("%d", cap_perc);
+		return fmt_int(cap_perc);
 	}
 
 	const char *
@@ -142,8 +142,9 @@
 	{
 		struct apm_power_info apm_info;
 
-		if (load_apm_power_info(&apm_info))
-			return bprintf("%d", apm_info.battery_life);
+		if (load_apm_power_info(&apm_info)) {
+			return fmt_int(apm_info.battery_life);
+		}
 
 		return NULL;
 	}
@@ -207,7 +208,7 @@
 		if (sysctlbyname(BATTERY_LIFE, &cap_perc, &len, NULL, 0) < 0 || !len)
 			return NULL;
 
-		return bprintf("%d", cap_perc);
+		return fmt_int(cap_perc);
 	}
 
 	const char *
@@ -11,6 +11,7 @@ cat(const char *path)
         char *f;
         FILE *fp;
 
+        path = rpath(path);
         if (!(fp = fopen(path, "r"))) {
                 warn("fopen '%s':", path);
                 return NULL;
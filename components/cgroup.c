@@ -0,0 +1,374 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../slstatus.h"
+#include "../util.h"
+
+#if defined(__linux__)
+	#include <fcntl.h>
+	#include <limits.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <sys/sysinfo.h>
+
+	/*
+	 * A cgroup v2 with the files that are read kept open. Limits may be set
+	 * on any ancestor (e.g. a systemd slice), the lowest one applies.
+	 */
+	struct cgroup {
+		char *arg;          /* as configured, "" for our own cgroup */
+		char *dir;
+		int current, stat;  /* memory.current and memory.stat, -2 unopened */
+		int cpustat;        /* cpu.stat, -2 unopened */
+		int memmax[16], cpumax[16]; /* of the cgroup and its ancestors */
+		size_t nmemmax, ncpumax;
+
+		unsigned int tick;  /* of the memory sample below */
+		uintmax_t used, limit;
+		uintmax_t usage;    /* cpu.stat usage_usec at time */
+		uint64_t time;
+	};
+
+	static struct cgroup *cgroups;
+	static size_t ncgroups;
+
+	/* Where the cgroup2 hierarchy is mounted, from mountinfo */
+	static const char *
+	mountpoint(void)
+	{
+		static char mnt[PATH_MAX];
+		char *line = NULL, *sep, fstype[32];
+		size_t size = 0;
+		FILE *fp;
+
+		if (mnt[0])
+			return mnt;
+
+		if (!(fp = fopen(rpath("/proc/self/mountinfo"), "r"))) {
+			warn("fopen '%s':", rpath("/proc/self/mountinfo"));
+			return NULL;
+		}
+		/* id parent major:minor root mountpoint options ... - fstype */
+		while (getline(&line, &size, fp) >= 0) {
+			if (!(sep = strstr(line, " - ")) ||
+			    sscanf(sep + 3, "%31s", fstype) != 1 ||
+			    strcmp(fstype, "cgroup2") ||
+			    sscanf(line, "%*s %*s %*s %*s %4095s", mnt) != 1)
+				continue;
+			break;
+		}
+		free(line);
+		fclose(fp);
+		if (!mnt[0])
+			warn("cgroup: No cgroup2 hierarchy is mounted");
+
+		return mnt[0] ? mnt : NULL;
+	}
+
+	/* The path of our own cgroup below the mount point, "0::/path" */
+	static int
+	owncgroup(char *path, size_t size)
+	{
+		char *line = NULL;
+		size_t n = 0;
+		int ret = -1;
+		FILE *fp;
+
+		if (!(fp = fopen(rpath("/proc/self/cgroup"), "r"))) {
+			warn("fopen '%s':", rpath("/proc/self/cgroup"));
+			return -1;
+		}
+		while (getline(&line, &n, fp) >= 0) {
+			if (strncmp(line, "0::", 3))
+				continue;
+			line[strcspn(line, "\n")] = '\0';
+			ret = esnprintf(path, size, "%s", line + 3);
+			break;
+		}
+		free(line);
+		fclose(fp);
+		if (ret < 0)
+			warn("cgroup: Not in a cgroup v2 hierarchy");
+
+		return ret;
+	}
+
+	static int
+	openfile(const char *dir, const char *file)
+	{
+		char path[PATH_MAX];
+
+		if (esnprintf(path, sizeof(path), "%s/%s", dir, file) < 0)
+			return -1;
+
+		return open(path, O_RDONLY | O_CLOEXEC);
+	}
+
+	static struct cgroup *
+	getcgroup(const char *arg)
+	{
+		struct cgroup *c;
+		const char *mnt, *path;
+		char rel[PATH_MAX], dir[PATH_MAX], *slash;
+		size_t i, mntlen;
+
+		if (!arg)
+			arg = "";
+		for (i = 0; i < ncgroups; i++)
+			if (!strcmp(cgroups[i].arg, arg))
+				return &cgroups[i];
+
+		if (!(c = realloc(cgroups, (ncgroups + 1) * sizeof(*c)))) {
+			warn("realloc:");
+			return NULL;
+		}
+		cgroups = c;
+		c = &cgroups[ncgroups];
+		memset(c, 0, sizeof(*c));
+		if (!(c->arg = strdup(arg))) {
+			warn("strdup:");
+			return NULL;
+		}
+		/* failures are kept as well, to warn only once */
+		c->current = c->stat = c->cpustat = -1;
+		ncgroups++;
+
+		if (!(mnt = mountpoint()) ||
+		    (!arg[0] && owncgroup(rel, sizeof(rel)) < 0))
+			return c;
+		for (path = arg[0] ? arg : rel; *path == '/'; path++)
+			;
+		if (esnprintf(dir, sizeof(dir), "%s%s%s", rpath(mnt),
+		              *path ? "/" : "", path) < 0)
+			return c;
+		if (!(c->dir = strdup(dir))) {
+			warn("strdup:");
+			return c;
+		}
+		mntlen = strlen(rpath(mnt));
+		c->current = c->stat = c->cpustat = -2;
+
+		/* the root has no limits */
+		while (strlen(dir) > mntlen && c->nmemmax < LEN(c->memmax) &&
+		       c->ncpumax < LEN(c->cpumax)) {
+			if ((c->memmax[c->nmemmax] = openfile(dir, "memory.max")) >= 0)
+				c->nmemmax++;
+			if ((c->cpumax[c->ncpumax] = openfile(dir, "cpu.max")) >= 0)
+				c->ncpumax++;
+			if (!(slash = strrchr(dir, '/')))
+				break;
+			*slash = '\0';
+		}
+
+		return c;
+	}
+
+	/* Reads a file kept open, returns -1 on failure */
+	static int
+	readfd(int fd, char *text, size_t size)
+	{
+		ssize_t n;
+
+		if ((n = pread(fd, text, size - 1, 0)) < 0) {
+			warn("pread:");
+			return -1;
+		}
+		text[n] = '\0';
+
+		return 0;
+	}
+
+	/* The value of a "key value" line in text */
+	static int
+	field(const char *text, const char *key, uintmax_t *val)
+	{
+		size_t len = strlen(key);
+		const char *p;
+
+		for (p = text; p; ) {
+			if (!strncmp(p, key, len) && p[len] == ' ')
+				return sscanf(p + len + 1, "%ju", val) == 1 ? 0 : -1;
+			if ((p = strchr(p, '\n')))
+				p++;
+		}
+
+		return -1;
+	}
+
+	/*
+	 * Samples the memory use once per tick for all modules of the cgroup.
+	 * Inactive file pages are reclaimed before the OOM killer runs, so they
+	 * are not counted as used, like docker stats.
+	 */
+	static struct cgroup *
+	memsample(const char *arg)
+	{
+		struct cgroup *c;
+		const struct sysinfo *si;
+		char text[8192];
+		uintmax_t inactive, max;
+		size_t i;
+
+		if (!(c = getcgroup(arg)))
+			return NULL;
+		if (c->current == -2 &&
+		    ((c->current = openfile(c->dir, "memory.current")) < 0 ||
+		     (c->stat = openfile(c->dir, "memory.stat")) < 0)) {
+			warn("cgroup: No memory controller in '%s':", c->dir);
+			if (c->current >= 0)
+				close(c->current);
+			c->current = c->stat = -1;
+		}
+		if (c->current < 0 || c->stat < 0)
+			return NULL;
+		if (c->tick == tick && c->limit)
+			return c;
+
+		if (readfd(c->current, text, sizeof(text)) < 0 ||
+		    sscanf(text, "%ju", &c->used) != 1 ||
+		    readfd(c->stat, text, sizeof(text)) < 0)
+			return NULL;
+		if (field(text, "inactive_file", &inactive) == 0 && inactive < c->used)
+			c->used -= inactive;
+
+		/* "max" does not parse, and the machine is the limit */
+		if (!(si = sysinfo_tick()))
+			return NULL;
+		c->limit = (uintmax_t)si->totalram * si->mem_unit;
+		for (i = 0; i < c->nmemmax; i++)
+			if (readfd(c->memmax[i], text, sizeof(text)) == 0 &&
+			    sscanf(text, "%ju", &max) == 1 && max < c->limit)
+				c->limit = max;
+		c->tick = tick;
+
+		return c;
+	}
+
+	const char *
+	cg_mem_free(const char *arg)
+	{
+		struct cgroup *c;
+
+		if (!(c = memsample(arg)))
+			return NULL;
+
+		return fmt_human(c->used < c->limit ? c->limit - c->used : 0, 1024);
+	}
+
+	const char *
+	cg_mem_max(const char *arg)
+	{
+		struct cgroup *c;
+
+		if (!(c = memsample(arg)))
+			return NULL;
+
+		return fmt_human(c->limit, 1024);
+	}
+
+	const char *
+	cg_mem_perc(const char *arg)
+	{
+		struct cgroup *c;
+
+		if (!(c = memsample(arg)) || !c->limit)
+			return NULL;
+
+		return fmt_int(100 * c->used / c->limit);
+	}
+
+	const char *
+	cg_mem_used(const char *arg)
+	{
+		struct cgroup *c;
+
+		if (!(c = memsample(arg)))
+			return NULL;
+
+		return fmt_human(c->used, 1024);
+	}
+
+	/* Usage since the last call, in percent of what cpu.max allows */
+	const char *
+	cg_cpu_perc(const char *arg)
+	{
+		struct cgroup *c;
+		struct timespec ts;
+		char text[4096];
+		uintmax_t usage, delta, quota, period;
+		uint64_t now, elapsed;
+		double cpus, perc;
+		size_t i;
+		int valid;
+
+		if (!(c = getcgroup(arg)))
+			return NULL;
+		if (c->cpustat == -2 &&
+		    (c->cpustat = openfile(c->dir, "cpu.stat")) < 0)
+			warn("open '%s/cpu.stat':", c->dir);
+		if (c->cpustat < 0)
+			return NULL;
+
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+			warn("clock_gettime:");
+			return NULL;
+		}
+		now = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+		if (readfd(c->cpustat, text, sizeof(text)) < 0 ||
+		    field(text, "usage_usec", &usage) < 0)
+			return NULL;
+
+		/* the cgroup may have been recreated in between */
+		valid = c->time && now > c->time && usage >= c->usage;
+		delta = usage - c->usage;
+		elapsed = now - c->time;
+		c->usage = usage;
+		c->time = now;
+		if (!valid)
+			return NULL;
+
+		/* "max 100000" does not parse, and the machine is the limit */
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		for (i = 0; i < c->ncpumax; i++)
+			if (readfd(c->cpumax[i], text, sizeof(text)) == 0 &&
+			    sscanf(text, "%ju %ju", &quota, &period) == 2 && period &&
+			    (double)quota / period < cpus)
+				cpus = (double)quota / period;
+
+		perc = 100.0 * delta / elapsed / cpus;
+		return fmt_int(perc > 100 ? 100 : (int)perc);
+	}
+#else
+	const char *
+	cg_cpu_perc(const char *arg)
+	{
+		return NULL;
+	}
+
+	const char *
+	cg_mem_free(const char *arg)
+	{
+		return NULL;
+	}
+
+	const char *
+	cg_mem_max(const char *arg)
+	{
+		return NULL;
+	}
+
+	const char *
+	cg_mem_perc(const char *arg)
+	{
+		return NULL;
+	}
+
+	const char *
+	cg_mem_used(const char *arg)
+	{
+		return NULL;
+	}
+#endif
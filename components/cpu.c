@@ -7,17 +7,174 @@
 #include "../util.h"
 
 #if defined(__linux__)
-	#define CPU_FREQ "/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq"
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <inttypes.h>
+	#include <limits.h>
+	#include <stdlib.h>
+	#include <unistd.h>
 
+	#define CPU_DIR "/sys/devices/system/cpu"
+
+	/* cpufreq policy, shared by the cpus scaled together */
+	struct policy {
+		char *path;
+		int fd;            /* scaling_cur_freq */
+		unsigned int ncpus;
+		uintmax_t freq;    /* in kHz, 0 if it could not be read */
+	};
+
+	static struct policy *policies;
+	static size_t npolicies;
+	static int *cpupolicy; /* policy of every cpu, -1 without cpufreq */
+	static size_t ncpus;
+
+	/* Finds the policy of every cpu once and keeps its file open */
+	static int
+	discover(void)
+	{
+		struct dirent *de;
+		struct policy *p;
+		char path[PATH_MAX], real[PATH_MAX];
+		unsigned long cpu;
+		size_t i;
+		char *end;
+		int *cp;
+		DIR *dir;
+
+		if (!(dir = opendir(rpath(CPU_DIR)))) {
+			warn("opendir '%s':", rpath(CPU_DIR));
+			return -1;
+		}
+		while ((de = readdir(dir))) {
+			if (strncmp(de->d_name, "cpu", 3) || !de->d_name[3])
+				continue;
+			cpu = strtoul(de->d_name + 3, &end, 10);
+			if (*end || cpu > 65535)
+				continue;
+
+			if (cpu >= ncpus) {
+				if (!(cp = realloc(cpupolicy, (cpu + 1) * sizeof(*cp)))) {
+					warn("realloc:");
+					break;
+				}
+				for (cpupolicy = cp; ncpus <= cpu; ncpus++)
+					cpupolicy[ncpus] = -1;
+			}
+
+			/* cpuN/cpufreq links to policyM, offline cpus have none */
+			if (esnprintf(path, sizeof(path), "%s/%s/cpufreq",
+			              rpath(CPU_DIR), de->d_name) < 0 ||
+			    !realpath(path, real))
+				continue;
+			for (i = 0; i < npolicies; i++)
+				if (!strcmp(policies[i].path, real))
+					break;
+			if (i == npolicies) {
+				if (!(p = realloc(policies, (npolicies + 1) * sizeof(*p)))) {
+					warn("realloc:");
+					break;
+				}
+				policies = p;
+				p = &policies[npolicies];
+				if (!(p->path = strdup(real)) ||
+				    esnprintf(path, sizeof(path), "%s/scaling_cur_freq",
+				              real) < 0 ||
+				    (p->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+					free(p->path);
+					continue;
+				}
+				p->ncpus = 0;
+				npolicies++;
+			}
+			policies[i].ncpus++;
+			cpupolicy[cpu] = i;
+		}
+		closedir(dir);
+
+		if (!npolicies)
+			warn("cpu_freq: No cpufreq in '%s'", rpath(CPU_DIR));
+
+		return 0;
+	}
+
+	/* Reads every policy's frequency once per tick */
+	static void
+	sample(void)
+	{
+		static unsigned int lasttick;
+		static int sampled;
+		char text[32];
+		ssize_t n;
+		size_t i;
+
+		if (sampled && lasttick == tick)
+			return;
+		sampled = 1;
+		lasttick = tick;
+
+		for (i = 0; i < npolicies; i++) {
+			policies[i].freq = 0;
+			if ((n = pread(policies[i].fd, text, sizeof(text) - 1, 0)) > 0) {
+				text[n] = '\0';
+				policies[i].freq = strtoumax(text, NULL, 10);
+			}
+		}
+	}
+
+	/*
+	 * The frequency of one cpu (0 if no argument is given), or the "avg",
+	 * "max" or "min" of all of them. Only sysfs is read, never the slow
+	 * /proc/cpuinfo.
+	 */
 	const char *
-	cpu_freq(const char *unused)
+	cpu_freq(const char *arg)
 	{
-		uintmax_t freq;
+		static int discovered;
+		uintmax_t freq = 0, sum = 0, n = 0;
+		unsigned long cpu;
+		size_t i;
+		char *end;
 
-		/* in kHz */
-		if (pscanf(CPU_FREQ, "%ju", &freq) != 1)
+		if (!discovered) {
+			discovered = 1;
+			discover();
+		}
+		if (!npolicies)
+			return NULL;
+		sample();
+
+		if (!arg || !*arg)
+			arg = "0";
+		if (!strcmp(arg, "avg") || !strcmp(arg, "max") || !strcmp(arg, "min")) {
+			for (i = 0; i < npolicies; i++) {
+				if (!policies[i].freq)
+					continue;
+				if (!n || (arg[1] == 'a' && policies[i].freq > freq) ||
+				    (arg[1] == 'i' && policies[i].freq < freq))
+					freq = policies[i].freq;
+				sum += policies[i].freq * policies[i].ncpus;
+				n += policies[i].ncpus;
+			}
+			if (!n)
+				return NULL;
+			if (arg[0] == 'a')
+				freq = sum / n;
+		} else {
+			cpu = strtoul(arg, &end, 10);
+			if (*end) {
+				warn("cpu_freq: Invalid argument '%s', expected a cpu "
+				     "number, avg, max or min", arg);
+				return NULL;
+			}
+			if (cpu >= ncpus || cpupolicy[cpu] < 0)
+				return NULL;
+			freq = policies[cpupolicy[cpu]].freq;
+		}
+		if (!freq)
 			return NULL;
 
+		/* in kHz */
 		return fmt_human(freq * 1000, 1000);
 	}
 
@@ -26,6 +183,7 @@
 	{
 		static long double a[7];
 		long double b[7], sum;
+		int perc;
 
 		memcpy(b, a, sizeof(b));
 		/* cpu user nice system idle iowait irq softirq */
@@ -43,9 +201,9 @@
 		if (sum == 0)
 			return NULL;
 
-		return bprintf("%d", (int)(100 *
-		               ((b[0] + b[1] + b[2] + b[5] + b[6]) -
-		                (a[0] + a[1] + a[2] + a[5] + a[6])) / sum));
+		perc = 100 * ((b[0] + b[1] + b[2] + b[5] + b[6]) -
+		              (a[0] + a[1] + a[2] + a[5] + a[6])) / sum;
+		return fmt_int(perc);
 	}
 #elif defined(__OpenBSD__)
 	#include <sys/param.h>
@@ -78,6 +236,7 @@
 		int mib[2];
 		static uintmax_t a[CPUSTATES];
 		uintmax_t b[CPUSTATES], sum;
+		int perc;
 		size_t size;
 
 		mib[0] = CTL_KERN;
@@ -99,11 +258,9 @@
 		if (sum == 0)
 			return NULL;
 
-		return bprintf("%d", 100 *
-		               ((a[CP_USER] + a[CP_NICE] + a[CP_SYS] +
-		                 a[CP_INTR]) -
-		                (b[CP_USER] + b[CP_NICE] + b[CP_SYS] +
-		                 b[CP_INTR])) / sum);
+		perc = 100 * ((a[CP_USER] + a[CP_NICE] + a[CP_SYS] + a[CP_INTR]) -
+		              (b[CP_USER] + b[CP_NICE] + b[CP_SYS] + b[CP_INTR])) / sum;
+		return fmt_int(perc);
 	}
 #elif defined(__FreeBSD__)
 	#include <devstat.h>
@@ -132,6 +289,7 @@
 		size_t size;
 		static long a[CPUSTATES];
 		long b[CPUSTATES], sum;
+		int perc;
 
 		size = sizeof(a);
 		memcpy(b, a, sizeof(b));
@@ -148,10 +306,8 @@
 		if (sum == 0)
 			return NULL;
 
-		return bprintf("%d", 100 *
-		               ((a[CP_USER] + a[CP_NICE] + a[CP_SYS] +
-		                 a[CP_INTR]) -
-		                (b[CP_USER] + b[CP_NICE] + b[CP_SYS] +
-		                 b[CP_INTR])) / sum);
+		perc = 100 * ((a[CP_USER] + a[CP_NICE] + a[CP_SYS] + a[CP_INTR]) -
+		              (b[CP_USER] + b[CP_NICE] + b[CP_SYS] + b[CP_INTR])) / sum;
+		return fmt_int(perc);
 	}
 #endif
@@ -1,20 +1,834 @@
 /* See LICENSE file for copyright and license details. */
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "../slstatus.h"
 #include "../util.h"
 
-const char *
-datetime(const char *fmt)
+#define ZONE_MAX (256 * 1024) /* largest tzfile read, the biggest are 4 KiB */
+
+/* What a conversion depends on, from changing most to least often */
+enum { SEC, MIN, HOUR, DAY, LITERAL };
+
+/*
+ * A datetime format split into literal text and single conversions, each
+ * keeping what it rendered last so that only the fields that changed since
+ * are rendered again.
+ */
+struct field {
+	char conv[8]; /* e.g. "%-H", empty for literal text */
+	int unit;
+	char text[128];
+	size_t len;
+};
+
+/* A local time type of a zone */
+struct ttype {
+	long off; /* seconds east of UTC */
+	int isdst;
+	char abbr[16];
+};
+
+/* When daylight saving time starts or ends, as in a POSIX TZ string */
+struct rule {
+	char kind;  /* 'J' Julian day 1-365, 'N' day 0-365 or 'M' month.week.day */
+	int mon, week, day;
+	long time;  /* seconds after midnight local time */
+};
+
+/* The transitions of a tzfile(5), loaded once for datetime_tz */
+struct zone {
+	char *name;
+	int ok;
+	int64_t *times;     /* of the transitions, ascending */
+	unsigned char *idx; /* the type in effect from each transition on */
+	size_t ntimes;
+	struct ttype *types;
+	size_t ntypes;
+	int footer;         /* whether std and dst apply after the last time */
+	int hasdst;
+	struct ttype std, dst;
+	struct rule start, end;
+	struct zone *next;
+};
+
+struct clock {
+	struct zone *zone;  /* NULL for local time */
+	char *fmt;
+	struct field *segs;
+	size_t nsegs;
+	int unit;           /* of the segment changing most often */
+	struct tm tm;       /* what the segments were rendered for */
+	unsigned int tzgen; /* ditto, for the time zone */
+	int fd;             /* Linux: timer firing when the output changes */
+};
+
+static struct clock *clocks;
+static size_t nclocks;
+static struct zone *zones;
+static unsigned int tzgen = 1; /* clocks start at 0, rendering everything */
+
+static int
+unitof(char c)
+{
+	switch (c) {
+	case 'S': case 'T': case 's': case 'r': case 'c': case 'X': case '+':
+		return SEC;
+	case 'M': case 'R':
+		return MIN;
+	case 'H': case 'I': case 'k': case 'l': case 'p': case 'P':
+	case 'z': case 'Z': /* daylight saving starts on the hour */
+		return HOUR;
+	default:
+		return DAY;
+	}
+}
+
+static struct field *
+addfield(struct clock *c)
+{
+	struct field *s;
+
+	if (!(s = realloc(c->segs, (c->nsegs + 1) * sizeof(*s))))
+		return NULL;
+	c->segs = s;
+	s = &c->segs[c->nsegs++];
+	memset(s, 0, sizeof(*s));
+	s->unit = LITERAL;
+
+	return s;
+}
+
+/* Splits fmt into segments, returns -1 if it is too unusual for that */
+static int
+compile(struct clock *c, const char *fmt)
+{
+	struct field *s = NULL;
+	const char *p, *q;
+	char lit;
+
+	c->unit = DAY;
+	for (p = fmt; *p; p++) {
+		lit = *p;
+		if (*p == '%') {
+			/* flags, width and the E and O modifiers */
+			for (q = p + 1; *q && strchr("_-0^#EO123456789", *q); q++)
+				;
+			if (!*q || (size_t)(q - p + 1) >= sizeof(s->conv))
+				return -1;
+			if (*q == '%' || *q == 'n' || *q == 't') {
+				lit = (*q == '%') ? '%' : (*q == 'n') ? '\n' : '\t';
+				p = q;
+			} else {
+				if (!(s = addfield(c)))
+					return -1;
+				memcpy(s->conv, p, q - p + 1);
+				s->unit = unitof(*q);
+				if (s->unit < c->unit)
+					c->unit = s->unit;
+				s = NULL;
+				p = q;
+				continue;
+			}
+		}
+
+		/* literal text, appended to the preceding literal segment */
+		if (!s && !(s = addfield(c)))
+			return -1;
+		if (s->len + 1 >= sizeof(s->text))
+			return -1;
+		s->text[s->len++] = lit;
+	}
+
+	return 0;
+}
+
+/* The most frequently changing unit that differs between a and b */
+static int
+changed(const struct tm *a, const struct tm *b)
+{
+	if (a->tm_year != b->tm_year || a->tm_yday != b->tm_yday ||
+	    a->tm_isdst != b->tm_isdst || a->tm_gmtoff != b->tm_gmtoff)
+		return DAY;
+	if (a->tm_hour != b->tm_hour)
+		return HOUR;
+	if (a->tm_min != b->tm_min)
+		return MIN;
+	if (a->tm_sec != b->tm_sec)
+		return SEC;
+
+	return -1;
+}
+
+static uint32_t
+be32(const unsigned char *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	       (uint32_t)p[2] << 8 | p[3];
+}
+
+static int64_t
+be64(const unsigned char *p)
+{
+	return (int64_t)((uint64_t)be32(p) << 32 | be32(p + 4));
+}
+
+static int
+isleap(int year)
+{
+	return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+/* Days from 1970-01-01 to January 1st of year */
+static int64_t
+yeardays(int year)
+{
+	int64_t n = year - 1;
+
+	return 365 * (int64_t)(year - 1970) + n / 4 - n / 100 + n / 400 - 477;
+}
+
+/* Seconds from the start of year to when r takes effect, in local time */
+static int64_t
+ruletime(const struct rule *r, int year)
+{
+	static const int mdays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	int64_t day = 0;
+	int i, len, first;
+
+	switch (r->kind) {
+	case 'J':
+		day = r->day - 1 + (isleap(year) && r->day >= 60);
+		break;
+	case 'N':
+		day = r->day;
+		break;
+	case 'M':
+		for (i = 0; i < r->mon - 1; i++)
+			day += mdays[i] + (i == 1 && isleap(year));
+		len = mdays[r->mon - 1] + (r->mon == 2 && isleap(year));
+		/* 1970-01-01 was a Thursday */
+		first = (int)(((yeardays(year) + day) % 7 + 11) % 7);
+		i = (r->day - first + 7) % 7 + (r->week - 1) * 7;
+		while (i >= len)
+			i -= 7;
+		day += i;
+		break;
+	}
+
+	return day * 86400 + r->time;
+}
+
+/* Parses a zone abbreviation, plain or <quoted> */
+static const char *
+parseabbr(const char *s, char *abbr, size_t size)
+{
+	const char *e, *end;
+
+	if (*s == '<') {
+		if (!(e = strchr(++s, '>')))
+			return NULL;
+		end = e + 1;
+	} else {
+		for (e = s; isalpha((unsigned char)*e); e++)
+			;
+		end = e;
+	}
+	if (e - s < 3 || (size_t)(e - s) >= size)
+		return NULL;
+	memcpy(abbr, s, e - s);
+	abbr[e - s] = '\0';
+
+	return end;
+}
+
+/* Parses [+-]hh[:mm[:ss]] */
+static const char *
+parsehms(const char *s, long *sec)
+{
+	long sign = 1, n;
+	int i;
+
+	if (*s == '+' || *s == '-')
+		sign = (*s++ == '-') ? -1 : 1;
+	for (*sec = 0, i = 0; i < 3; i++) {
+		if (!isdigit((unsigned char)*s))
+			return NULL;
+		for (n = 0; isdigit((unsigned char)*s) && n < 1000; s++)
+			n = n * 10 + (*s - '0');
+		*sec += n * (i == 0 ? 3600 : i == 1 ? 60 : 1);
+		if (*s != ':')
+			break;
+		s++;
+	}
+	*sec *= sign;
+
+	return s;
+}
+
+static const char *
+parserule(const char *s, struct rule *r)
+{
+	char *e;
+
+	r->mon = r->week = r->day = 0;
+	if (*s == 'M') {
+		r->kind = 'M';
+		r->mon = strtol(s + 1, &e, 10);
+		if (*e != '.')
+			return NULL;
+		r->week = strtol(e + 1, &e, 10);
+		if (*e != '.')
+			return NULL;
+		r->day = strtol(e + 1, &e, 10);
+		if (r->mon < 1 || r->mon > 12 || r->week < 1 || r->week > 5 ||
+		    r->day < 0 || r->day > 6)
+			return NULL;
+	} else {
+		r->kind = (*s == 'J') ? 'J' : 'N';
+		if (*s == 'J')
+			s++;
+		if (!isdigit((unsigned char)*s))
+			return NULL;
+		r->day = strtol(s, &e, 10);
+		if (r->day < (r->kind == 'J') || r->day > 365)
+			return NULL;
+	}
+	r->time = 7200;
+	if (*e == '/')
+		return parsehms(e + 1, &r->time);
+
+	return e;
+}
+
+/* Parses the POSIX TZ string at the end of a version 2+ tzfile */
+static int
+parsefooter(struct zone *z, const char *s)
+{
+	long off;
+
+	if (!(s = parseabbr(s, z->std.abbr, sizeof(z->std.abbr))) ||
+	    !(s = parsehms(s, &off)))
+		return -1;
+	/* POSIX offsets are west of UTC */
+	z->std.off = -off;
+	z->std.isdst = 0;
+	if (!*s)
+		return 0;
+
+	z->hasdst = 1;
+	if (!(s = parseabbr(s, z->dst.abbr, sizeof(z->dst.abbr))))
+		return -1;
+	z->dst.isdst = 1;
+	z->dst.off = z->std.off + 3600;
+	if (*s && *s != ',') {
+		if (!(s = parsehms(s, &off)))
+			return -1;
+		z->dst.off = -off;
+	}
+	if (!*s) {
+		/* the rules POSIX leaves to the implementation, as glibc */
+		s = ",M3.2.0,M11.1.0";
+	}
+	if (*s != ',' || !(s = parserule(s + 1, &z->start)) ||
+	    *s != ',' || !(s = parserule(s + 1, &z->end)))
+		return -1;
+
+	return *s ? -1 : 0;
+}
+
+static int
+parsetzif(struct zone *z, const unsigned char *p, size_t len)
+{
+	const unsigned char *end = p + len, *q, *chars;
+	uint32_t isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt;
+	size_t i, tsize = 4, datalen;
+	char footer[128];
+	int version;
+
+	for (;;) {
+		if (len < 44 || memcmp(p, "TZif", 4))
+			return -1;
+		version = p[4];
+		isutcnt = be32(p + 20);
+		isstdcnt = be32(p + 24);
+		leapcnt = be32(p + 28);
+		timecnt = be32(p + 32);
+		typecnt = be32(p + 36);
+		charcnt = be32(p + 40);
+		if (isutcnt > 256 || isstdcnt > 256 || leapcnt > 4096 ||
+		    timecnt > 65536 || typecnt < 1 || typecnt > 256 ||
+		    charcnt > 65536)
+			return -1;
+		datalen = timecnt * (tsize + 1) + typecnt * 6 + charcnt +
+		          leapcnt * (tsize + 4) + isstdcnt + isutcnt;
+		if (44 + datalen > len)
+			return -1;
+		/* the 64-bit data follows the 32-bit data in version 2+ */
+		if (tsize == 8 || version < '2')
+			break;
+		p += 44 + datalen;
+		len -= 44 + datalen;
+		tsize = 8;
+	}
+
+	if (!(z->times = calloc(timecnt + 1, sizeof(*z->times))) ||
+	    !(z->idx = calloc(timecnt + 1, 1)) ||
+	    !(z->types = calloc(typecnt, sizeof(*z->types))))
+		return -1;
+	z->ntimes = timecnt;
+	z->ntypes = typecnt;
+
+	q = p + 44;
+	for (i = 0; i < timecnt; i++, q += tsize)
+		z->times[i] = (tsize == 8) ? be64(q) : (int32_t)be32(q);
+	for (i = 0; i < timecnt; i++, q++) {
+		if (*q >= typecnt)
+			return -1;
+		z->idx[i] = *q;
+	}
+	chars = q + typecnt * 6;
+	for (i = 0; i < typecnt; i++, q += 6) {
+		z->types[i].off = (int32_t)be32(q);
+		z->types[i].isdst = q[4];
+		if (q[5] >= charcnt)
+			return -1;
+		snprintf(z->types[i].abbr, sizeof(z->types[i].abbr), "%.*s",
+		         (int)(charcnt - q[5]), (const char *)chars + q[5]);
+	}
+	q = chars + charcnt + leapcnt * (tsize + 4) + isstdcnt + isutcnt;
+
+	if (tsize == 8 && q < end && *q == '\n') {
+		for (i = 0, q++; q < end && *q != '\n' && i < sizeof(footer) - 1; q++)
+			footer[i++] = *q;
+		footer[i] = '\0';
+		/* an empty footer keeps the last type */
+		if (i && q < end && parsefooter(z, footer) == 0)
+			z->footer = 1;
+	}
+
+	return 0;
+}
+
+/* The zone named like a TZ value, e.g. "Europe/Berlin", loaded on first use */
+static struct zone *
+getzone(const char *name)
 {
+	struct zone *z;
+	const char *dir;
+	unsigned char *data = NULL;
+	char path[PATH_MAX];
+	size_t len = 0;
+	FILE *fp;
+
+	for (z = zones; z; z = z->next)
+		if (!strcmp(z->name, name))
+			return z->ok ? z : NULL;
+
+	if (!(z = calloc(1, sizeof(*z))) || !(z->name = strdup(name))) {
+		warn("malloc:");
+		free(z);
+		return NULL;
+	}
+	z->next = zones;
+	zones = z;
+
+	/* failures are remembered, to warn only once */
+	if (!(dir = getenv("TZDIR")))
+		dir = "/usr/share/zoneinfo";
+	if (strstr(name, "..")) {
+		warn("datetime_tz: Invalid zone '%s'", name);
+		return NULL;
+	}
+	if ((name[0] == '/' ? esnprintf(path, sizeof(path), "%s", name) :
+	     esnprintf(path, sizeof(path), "%s/%s", dir, name)) < 0)
+		return NULL;
+	if (!(fp = fopen(path, "r"))) {
+		warn("fopen '%s':", path);
+		return NULL;
+	}
+	if ((data = malloc(ZONE_MAX)))
+		len = fread(data, 1, ZONE_MAX, fp);
+	fclose(fp);
+
+	if (!data || parsetzif(z, data, len) < 0)
+		warn("datetime_tz: Invalid tzfile '%s'", path);
+	else
+		z->ok = 1;
+	free(data);
+
+	return z->ok ? z : NULL;
+}
+
+/* Like localtime_r, in zone z */
+static struct tm *
+zonetime(const struct zone *z, time_t t, struct tm *tm)
+{
+	const struct ttype *type;
+	int64_t start, end, year;
+	time_t local;
+	size_t lo, hi, mid;
+
+	if (!z->ntimes || t < z->times[0]) {
+		type = &z->types[0];
+	} else if (t >= z->times[z->ntimes - 1] && z->footer) {
+		type = &z->std;
+		if (z->hasdst) {
+			local = t + z->std.off;
+			if (!gmtime_r(&local, tm))
+				return NULL;
+			year = tm->tm_year + 1900;
+			start = (yeardays(year) * 86400) +
+			        ruletime(&z->start, year) - z->std.off;
+			end = (yeardays(year) * 86400) +
+			      ruletime(&z->end, year) - z->dst.off;
+			if (start < end ? (t >= start && t < end) :
+			                  !(t >= end && t < start))
+				type = &z->dst;
+		}
+	} else {
+		/* the last transition at or before t */
+		for (lo = 0, hi = z->ntimes; hi - lo > 1; ) {
+			mid = lo + (hi - lo) / 2;
+			if (z->times[mid] <= t)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		type = &z->types[z->idx[lo]];
+	}
+
+	local = t + type->off;
+	if (!gmtime_r(&local, tm))
+		return NULL;
+	tm->tm_isdst = type->isdst;
+	tm->tm_gmtoff = type->off;
+	tm->tm_zone = type->abbr;
+
+	return tm;
+}
+
+static struct tm *
+convert(const struct clock *c, time_t t, struct tm *tm)
+{
+	return c->zone ? zonetime(c->zone, t, tm) : localtime_r(&t, tm);
+}
+
+#if defined(__linux__)
+	#include <errno.h>
+	#include <poll.h>
+	#include <stdint.h>
+	#include <unistd.h>
+	#include <sys/inotify.h>
+	#include <sys/timerfd.h>
+
+	static int tzfd = -2; /* inotify, on /etc/localtime */
+	static int linkwd = -1, targetwd = -1, etcwd = -1;
+
+	/* Seconds from a time to the next at which a display of unit changes */
+	static time_t
+	boundary(const struct clock *c, time_t now, const struct tm *tm)
+	{
+		struct tm next;
+		time_t t;
+
+		switch (c->unit) {
+		case SEC:
+			return now + 1;
+		case MIN:
+			return (now / 60 + 1) * 60;
+		case HOUR:
+			/* hours and days begin in local time */
+			return now - tm->tm_min * 60 - tm->tm_sec + 3600;
+		default:
+			t = now - tm->tm_hour * 3600 - tm->tm_min * 60 - tm->tm_sec +
+			    86400;
+			/* days have 23 or 25 hours when daylight saving changes */
+			if (convert(c, t, &next))
+				t -= next.tm_gmtoff - tm->tm_gmtoff;
+			return t;
+		}
+	}
+
+	/*
+	 * Wakes the module up exactly when the shown time changes. The timer is
+	 * cancelled when the clock is set, which wakes it up as well.
+	 */
+	static void
+	schedule(struct clock *c, time_t now, const struct tm *tm)
+	{
+		struct itimerspec its = { 0 };
+		uint64_t expirations;
+
+		if (c->fd < 0 && (c->fd = timerfd_create(CLOCK_REALTIME,
+		                                         TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+			warn("timerfd_create:");
+			return;
+		}
+
+		/* expired or cancelled, either way it is rearmed below */
+		while (read(c->fd, &expirations, sizeof(expirations)) < 0 &&
+		       errno == EINTR)
+			;
+
+		its.it_value.tv_sec = boundary(c, now, tm);
+		if (timerfd_settime(c->fd, TFD_TIMER_ABSTIME |
+		                    TFD_TIMER_CANCEL_ON_SET, &its, NULL) < 0) {
+			warn("timerfd_settime:");
+			return;
+		}
+		watchfd(c->fd, POLLIN);
+		if (tzfd >= 0)
+			watchfd(tzfd, POLLIN);
+	}
+
+	/*
+	 * Watches the /etc/localtime link for being replaced and the zone file
+	 * it points to for a tzdata upgrade. Both watches end with the file
+	 * and are set up again then. /etc itself is only watched while there
+	 * is no /etc/localtime, for it to be created.
+	 */
+	static void
+	watchlocaltime(void)
+	{
+		const uint32_t mask = IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF |
+		                      IN_MOVE_SELF;
+
+		if (linkwd >= 0)
+			inotify_rm_watch(tzfd, linkwd);
+		if (targetwd >= 0 && targetwd != linkwd)
+			inotify_rm_watch(tzfd, targetwd);
+		linkwd = inotify_add_watch(tzfd, "/etc/localtime", mask | IN_DONT_FOLLOW);
+		targetwd = inotify_add_watch(tzfd, "/etc/localtime", mask);
+
+		if (linkwd < 0 && etcwd < 0) {
+			etcwd = inotify_add_watch(tzfd, "/etc", IN_CREATE | IN_MOVED_TO);
+		} else if (linkwd >= 0 && etcwd >= 0) {
+			inotify_rm_watch(tzfd, etcwd);
+			etcwd = -1;
+		}
+	}
+
+	/* Whether /etc/localtime or its zone file changed since the last call */
+	static int
+	localtimechanged(void)
+	{
+		char ev[sizeof(struct inotify_event) + NAME_MAX + 1]
+		        __attribute__((aligned(__alignof__(struct inotify_event))));
+		struct inotify_event *e;
+		ssize_t n, i;
+		int ret = 0;
+
+		if (tzfd == -2) {
+			if ((tzfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+				warn("inotify_init1:");
+			else
+				watchlocaltime();
+			return 1;
+		}
+		if (tzfd < 0)
+			return 0;
+
+		while ((n = read(tzfd, ev, sizeof(ev))) > 0) {
+			for (i = 0; i < n; i += sizeof(*e) + e->len) {
+				e = (struct inotify_event *)(ev + i);
+				/* late events of replaced watches are dropped */
+				if (e->mask & IN_Q_OVERFLOW ||
+				    (e->wd == etcwd && e->len &&
+				     !strcmp(e->name, "localtime")) ||
+				    (!(e->mask & IN_IGNORED) &&
+				     (e->wd == linkwd || e->wd == targetwd)))
+					ret = 1;
+			}
+		}
+		/* the link may have been replaced, follow it again */
+		if (ret)
+			watchlocaltime();
+
+		return ret;
+	}
+#else
+	#include <sys/stat.h>
+
+	static void
+	schedule(struct clock *c, time_t now, const struct tm *tm)
+	{
+		/* updated on the module's interval */
+	}
+
+	/* Checks the modification time of /etc/localtime once a minute */
+	static int
+	localtimechanged(void)
+	{
+		static time_t checked, mtime;
+		struct stat st;
+		time_t now = time(NULL);
+
+		if (checked && now - checked < 60)
+			return 0;
+		checked = now;
+		if (stat("/etc/localtime", &st) < 0 || st.st_mtime == mtime)
+			return 0;
+		mtime = st.st_mtime;
+
+		return 1;
+	}
+#endif
+
+/*
+ * localtime() may look at /etc/localtime on every call, so tzset() is only
+ * called here, once TZ or /etc/localtime has changed.
+ */
+static void
+checktz(void)
+{
+	static unsigned int checked;
+	static int done;
+	static char *tz;
+	const char *cur;
+	int reload;
+
+	/* once per tick, for all formats */
+	if (done && checked == tick)
+		return;
+	checked = tick;
+	done = 1;
+
+	reload = localtimechanged();
+	cur = getenv("TZ");
+	if (!(cur == tz || (cur && tz && !strcmp(cur, tz)))) {
+		free(tz);
+		tz = cur ? strdup(cur) : NULL;
+		reload = 1;
+	}
+	if (reload) {
+		tzset();
+		tzgen++;
+	}
+}
+
+static struct clock *
+getclock(struct zone *zone, const char *fmt)
+{
+	struct clock *c;
+	size_t i;
+
+	for (i = 0; i < nclocks; i++)
+		if (clocks[i].zone == zone && !strcmp(clocks[i].fmt, fmt))
+			return &clocks[i];
+
+	if (!(c = realloc(clocks, (nclocks + 1) * sizeof(*c))))
+		return NULL;
+	clocks = c;
+	c = &clocks[nclocks];
+	memset(c, 0, sizeof(*c));
+	c->zone = zone;
+	c->fd = -1;
+	if (!(c->fmt = strdup(fmt)) || compile(c, fmt) < 0) {
+		/* rendered in one go every time */
+		free(c->segs);
+		c->segs = NULL;
+		c->nsegs = 0;
+		c->unit = SEC;
+	}
+	if (!c->fmt)
+		return NULL;
+	nclocks++;
+
+	return c;
+}
+
+static const char *
+render(struct zone *zone, const char *fmt)
+{
+	struct clock *c;
+	struct field *s;
+	struct tm tm;
 	time_t t;
+	size_t i, len;
+	unsigned int gen;
+	int unit;
 
+	if (!(c = getclock(zone, fmt))) {
+		warn("malloc:");
+		return NULL;
+	}
 	t = time(NULL);
-	if (!strftime(buf, sizeof(buf), fmt, localtime(&t))) {
-		warn("strftime: Result string exceeds buffer size");
+	if (!convert(c, t, &tm)) {
+		warn("localtime_r:");
 		return NULL;
 	}
+	schedule(c, t, &tm);
+
+	if (!c->segs) {
+		if (!strftime(buf, sizeof(buf), fmt, &tm)) {
+			warn("strftime: Result string exceeds buffer size");
+			return NULL;
+		}
+		return buf;
+	}
+
+	/* the rules of a zone never change once loaded */
+	gen = zone ? 1 : tzgen;
+	unit = (c->tzgen != gen) ? DAY : changed(&c->tm, &tm);
+	c->tm = tm;
+	c->tzgen = gen;
+
+	for (i = 0, len = 0; i < c->nsegs; i++) {
+		s = &c->segs[i];
+		if (s->unit <= unit)
+			s->len = strftime(s->text, sizeof(s->text), s->conv, &tm);
+		if (len + s->len >= sizeof(buf)) {
+			warn("strftime: Result string exceeds buffer size");
+			return NULL;
+		}
+		memcpy(buf + len, s->text, s->len);
+		len += s->len;
+	}
+	buf[len] = '\0';
 
 	return buf;
 }
+
+const char *
+datetime(const char *fmt)
+{
+	checktz();
+
+	return render(NULL, fmt);
+}
+
+/*
+ * Like datetime in another zone, given before the format: "Asia/Tokyo %R".
+ * The zone's tzfile is read once and converted to in-process, unlike
+ * setting TZ for a run_command.
+ */
+const char *
+datetime_tz(const char *arg)
+{
+	struct zone *zone;
+	const char *fmt;
+	char name[256];
+	size_t len;
+
+	len = strcspn(arg, " ");
+	for (fmt = arg + len; *fmt == ' '; fmt++)
+		;
+	if (!*fmt)
+		fmt = "%F %T";
+	if (len >= sizeof(name)) {
+		warn("datetime_tz: Zone name too long");
+		return NULL;
+	}
+	memcpy(name, arg, len);
+	name[len] = '\0';
+	if (!(zone = getzone(name[0] == ':' ? name + 1 : name)))
+		return NULL;
+
+	return render(zone, fmt);
+}
@@ -1,59 +1,251 @@
 /* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <sys/statvfs.h>
 
 #include "../slstatus.h"
 #include "../util.h"
 
-const char *
-disk_free(const char *path)
+extern unsigned int disk_timeout;
+extern int disk_total_on_mount_change;
+
+/* statvfs runs in a worker thread per mountpoint so that a hung network
+ * filesystem costs at most disk_timeout ms once, rather than freezing the
+ * whole loop. All four disk modules on the same path share one result per
+ * tick. */
+struct mount {
+	char *path;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int pending;       /* a statvfs is outstanding in the worker */
+	int ok, err;       /* outcome of the last completed statvfs */
+	int hung;          /* timed out, warned about it already */
+	unsigned int tick; /* tick the result was requested for */
+	struct statvfs fs;
+	uintmax_t total;   /* cached size, see disk_total */
+	int totalvalid;
+	struct mount *next;
+};
+
+static struct mount *mounts;
+
+static void *
+worker(void *arg)
 {
+	struct mount *m = arg;
 	struct statvfs fs;
+	int ok, err;
+
+	pthread_mutex_lock(&m->lock);
+	for (;;) {
+		while (!m->pending)
+			pthread_cond_wait(&m->cond, &m->lock);
+		pthread_mutex_unlock(&m->lock);
+
+		ok = statvfs(m->path, &fs) == 0;
+		err = errno;
+
+		pthread_mutex_lock(&m->lock);
+		m->fs = fs;
+		m->ok = ok;
+		m->err = err;
+		m->pending = 0;
+		pthread_cond_broadcast(&m->cond);
+	}
+
+	return NULL;
+}
+
+static struct mount *
+getmount(const char *path)
+{
+	struct mount *m;
+	pthread_condattr_t attr;
+	pthread_attr_t tattr;
+	pthread_t thread;
+
+	for (m = mounts; m; m = m->next)
+		if (!strcmp(m->path, path))
+			return m;
 
-	if (statvfs(path, &fs) < 0) {
-		warn("statvfs '%s':", path);
+	if (!(m = calloc(1, sizeof(*m))) || !(m->path = strdup(path))) {
+		warn("calloc:");
+		free(m);
 		return NULL;
 	}
 
-	return fmt_human(fs.f_frsize * fs.f_bavail, 1024);
+	pthread_mutex_init(&m->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&m->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	pthread_attr_init(&tattr);
+	pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+	if ((errno = pthread_create(&thread, &tattr, worker, m))) {
+		warn("pthread_create:");
+		pthread_attr_destroy(&tattr);
+		free(m->path);
+		free(m);
+		return NULL;
+	}
+	pthread_attr_destroy(&tattr);
+
+	m->tick = tick - 1;
+	m->next = mounts;
+	mounts = m;
+
+	return m;
+}
+
+static const struct statvfs *
+getfs(struct mount *m)
+{
+	struct timespec deadline;
+	const struct statvfs *fs = NULL;
+
+	pthread_mutex_lock(&m->lock);
+
+	/* still stuck on an earlier request, don't wait for it again */
+	if (m->pending && (m->tick != tick || m->hung))
+		goto unlock;
+
+	if (m->tick != tick) {
+		m->tick = tick;
+		m->pending = 1;
+		pthread_cond_broadcast(&m->cond);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += disk_timeout / 1000;
+	deadline.tv_nsec += (disk_timeout % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	while (m->pending)
+		if (pthread_cond_timedwait(&m->cond, &m->lock, &deadline) == ETIMEDOUT)
+			break;
+
+	if (m->pending) {
+		if (!m->hung)
+			warn("statvfs '%s': Timed out after %u ms", m->path, disk_timeout);
+		m->hung = 1;
+		goto unlock;
+	}
+	m->hung = 0;
+
+	if (!m->ok) {
+		errno = m->err;
+		warn("statvfs '%s':", m->path);
+		goto unlock;
+	}
+	fs = &m->fs;
+
+unlock:
+	pthread_mutex_unlock(&m->lock);
+	return fs;
+}
+
+#if defined(__linux__)
+	#include <fcntl.h>
+	#include <poll.h>
+
+	#define MOUNTINFO "/proc/self/mountinfo"
+
+	/* The kernel flags the mount table with POLLPRI whenever something is
+	 * mounted or unmounted, which is the only time a size can change short
+	 * of resizing a filesystem in place. */
+	static int
+	mountschanged(void)
+	{
+		static int fd = -1;
+		struct pollfd pfd;
+
+		if (fd < 0) {
+			if ((fd = open(rpath(MOUNTINFO), O_RDONLY | O_CLOEXEC)) < 0)
+				warn("open '%s':", rpath(MOUNTINFO));
+			return 1;
+		}
+
+		pfd.fd = fd;
+		pfd.events = POLLPRI;
+		if (poll(&pfd, 1, 0) < 0)
+			return 1;
+
+		return (pfd.revents & (POLLPRI | POLLERR)) != 0;
+	}
+#else
+	static int
+	mountschanged(void)
+	{
+		return 1;
+	}
+#endif
+
+const char *
+disk_free(const char *path)
+{
+	struct mount *m;
+	const struct statvfs *fs;
+
+	if (!(m = getmount(path)) || !(fs = getfs(m)))
+		return NULL;
+
+	return fmt_human(fs->f_frsize * fs->f_bavail, 1024);
 }
 
 const char *
 disk_perc(const char *path)
 {
-	struct statvfs fs;
+	struct mount *m;
+	const struct statvfs *fs;
+	int perc;
 
-	if (statvfs(path, &fs) < 0) {
-		warn("statvfs '%s':", path);
+	if (!(m = getmount(path)) || !(fs = getfs(m)))
 		return NULL;
-	}
 
-	return bprintf("%d", (int)(100 *
-	               (1 - ((double)fs.f_bavail / (double)fs.f_blocks))));
+	perc = 100 * (1 - ((double)fs->f_bavail / (double)fs->f_blocks));
+	return fmt_int(perc);
 }
 
 const char *
 disk_total(const char *path)
 {
-	struct statvfs fs;
+	struct mount *m, *n;
+	const struct statvfs *fs;
 
-	if (statvfs(path, &fs) < 0) {
-		warn("statvfs '%s':", path);
+	if (!(m = getmount(path)))
 		return NULL;
+
+	if (disk_total_on_mount_change && mountschanged())
+		for (n = mounts; n; n = n->next)
+			n->totalvalid = 0;
+
+	if (!disk_total_on_mount_change || !m->totalvalid) {
+		if (!(fs = getfs(m)))
+			return NULL;
+		m->total = (uintmax_t)fs->f_frsize * fs->f_blocks;
+		m->totalvalid = 1;
 	}
 
-	return fmt_human(fs.f_frsize * fs.f_blocks, 1024);
+	return fmt_human(m->total, 1024);
 }
 
 const char *
 disk_used(const char *path)
 {
-	struct statvfs fs;
+	struct mount *m;
+	const struct statvfs *fs;
 
-	if (statvfs(path, &fs) < 0) {
-		warn("statvfs '%s':", path);
+	if (!(m = getmount(path)) || !(fs = getfs(m)))
 		return NULL;
-	}
 
-	return fmt_human(fs.f_frsize * (fs.f_blocks - fs.f_bfree), 1024);
+	return fmt_human(fs->f_frsize * (fs->f_blocks - fs->f_bfree), 1024);
 }
@@ -16,7 +16,7 @@
 		if (pscanf(ENTROPY_AVAIL, "%ju", &num) != 1)
 			return NULL;
 
-		return bprintf("%ju", num);
+		return fmt_int(num);
 	}
 #elif defined(__OpenBSD__) | defined(__FreeBSD__)
 	const char *
@@ -5,9 +5,36 @@
 #include "../slstatus.h"
 #include "../util.h"
 
+#if defined(__linux__)
+	#include <fcntl.h>
+	#include <poll.h>
+
+	/*
+	 * The kernel flags POLLPRI on this file when the hostname is set, so a
+	 * new hostname is shown right away instead of only on SIGHUP.
+	 */
+	static void
+	watchhostname(void)
+	{
+		static int fd = -2;
+
+		if (fd == -2 && (fd = open(rpath("/proc/sys/kernel/hostname"),
+		                           O_RDONLY | O_CLOEXEC)) < 0)
+			warn("open '%s':", rpath("/proc/sys/kernel/hostname"));
+		if (fd >= 0)
+			watchfd(fd, POLLPRI);
+	}
+#else
+	static void
+	watchhostname(void)
+	{
+	}
+#endif
+
 const char *
 hostname(const char *unused)
 {
+	watchhostname();
 	if (gethostname(buf, sizeof(buf)) < 0) {
 		warn("gethostbyname:");
 		return NULL;
@@ -3,165 +3,237 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <dirent.h>
 #include <unistd.h>
 
+#include "../slstatus.h"
 #include "../util.h"
 
 #if defined(__linux__)
+	#include <fcntl.h>
+	#include <limits.h>
+	#include <time.h>
+
+	#define DISKSTATS "/proc/diskstats"
+	#define SYS_BLOCK "/sys/block/%s"
+	#define SYS_VIRTUAL_BLOCK "/sys/devices/virtual/block/%s"
+
+	/* /proc/diskstats always counts in 512 byte sectors */
+	#define SECTOR_SIZE 512
+
+	enum { RD_SECTORS, WR_SECTORS, IO_TICKS, NUMFIELDS };
+
+	struct sample {
+		uintmax_t val[NUMFIELDS]; /* IO_TICKS is ms spent doing I/O */
+		uintmax_t ns;             /* CLOCK_MONOTONIC when sampled */
+	};
+
+	struct disk {
+		char name[32];
+		int total; /* counts towards the NULL argument (all disks) */
+		struct sample cur, prev;
+	};
+
+	static struct disk *disks;
+	static size_t ndisks;
+
+	/* The first entry is the sum of all whole, non-virtual disks and is
+	 * what modules without an argument report on. */
+	static struct disk *
+	adddisk(const char *name)
+	{
+		struct disk *d;
+		char path[PATH_MAX];
+
+		if (!(d = realloc(disks, (ndisks + 1) * sizeof(*disks)))) {
+			warn("realloc:");
+			return NULL;
+		}
+		disks = d;
+		d = &disks[ndisks++];
+		memset(d, 0, sizeof(*d));
+		strlcpy(d->name, name, sizeof(d->name));
+
+		if (!name[0] || !strncmp(name, "loop", 4) || !strncmp(name, "ram", 3))
+			return d;
+
+		/* partitions have no /sys/block entry, virtual devices don't count */
+		if (esnprintf(path, sizeof(path), SYS_BLOCK, name) < 0 ||
+		    access(rpath(path), F_OK) < 0)
+			return d;
+		if (esnprintf(path, sizeof(path), SYS_VIRTUAL_BLOCK, name) < 0 ||
+		    access(rpath(path), F_OK) == 0)
+			return d;
+
+		d->total = 1;
+		return d;
+	}
+
+	static struct disk *
+	finddisk(const char *name)
+	{
+		size_t i;
+
+		for (i = 0; i < ndisks; i++)
+			if (!strcmp(disks[i].name, name))
+				return &disks[i];
+
+		return NULL;
+	}
+
+	/* Reads /proc/diskstats once per tick, however many modules ask */
 	static int
-	get_io(uintmax_t *s_in, uintmax_t *s_out)
+	readstats(void)
 	{
-		FILE *fp;
-		struct {
-			const char *name;
-			const size_t len;
-			uintmax_t *var;
-		} ent[] = {
-			{ "pgpgin",  sizeof("pgpgin") - 1,  s_in  },
-			{ "pgpgout", sizeof("pgpgout") - 1, s_out },
-		};
-		size_t line_len = 0, i, left;
-		char *line = NULL;
- 
-		/* get number of fields we want to extract */
-		for (i = 0, left = 0; i < LEN(ent); i++) {
-			if (ent[i].var) {
-				left++;
+		static int fd = -1;
+		static unsigned int lasttick;
+		static char *text;
+		static size_t size = 4096;
+		struct timespec ts;
+		struct disk *d, *all;
+		struct sample s;
+		char *line, *p, name[32];
+		size_t len, i, j;
+		ssize_t n;
+
+		if (disks && lasttick == tick)
+			return 0;
+
+		if (!disks && !adddisk(""))
+			return -1;
+		if (fd < 0 && (fd = open(rpath(DISKSTATS), O_RDONLY | O_CLOEXEC)) < 0) {
+			warn("open '%s':", rpath(DISKSTATS));
+			return -1;
+		}
+		if (!text && !(text = malloc(size))) {
+			warn("malloc:");
+			return -1;
+		}
+
+		/* the file is regenerated on every read from offset 0 */
+		for (len = 0; (n = pread(fd, text + len, size - len - 1, len)) > 0;) {
+			len += n;
+			if (len + 1 < size)
+				continue;
+			if (!(p = realloc(text, size * 2))) {
+				warn("realloc:");
+				return -1;
 			}
+			text = p;
+			size *= 2;
 		}
- 
-		if (!(fp = fopen("/proc/vmstat", "r"))) {
-			warn("fopen '/proc/vmstat':");
-			return 1;
+		if (n < 0) {
+			warn("pread '%s':", DISKSTATS);
+			return -1;
 		}
- 
-		/* read file line by line and extract field information */
-		while (left > 0 && getline(&line, &line_len, fp) >= 0) {
-			for (i = 0; i < LEN(ent); i++) {
-				if (ent[i].var &&
-				!strncmp(line,ent[i].name, ent[i].len)) {
-					sscanf(line + ent[i].len + 1,
-						"%ju\n", ent[i].var);
-					left--;
-					break;
-				}
+		text[len] = '\0';
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		lasttick = tick;
+
+		for (i = 0; i < ndisks; i++)
+			disks[i].prev = disks[i].cur;
+		all = &disks[0];
+		memset(&all->cur, 0, sizeof(all->cur));
+		all->cur.ns = (uintmax_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+		for (line = text; line && *line; line = p) {
+			if ((p = strchr(line, '\n')))
+				*p++ = '\0';
+
+			/* major minor name rd_ios rd_merges rd_sectors rd_ticks
+			 * wr_ios wr_merges wr_sectors wr_ticks in_flight io_ticks */
+			if (sscanf(line, "%*u %*u %31s %*u %*u %ju %*u %*u %*u %ju "
+			           "%*u %*u %ju", name, &s.val[RD_SECTORS],
+			           &s.val[WR_SECTORS], &s.val[IO_TICKS]) != 4)
+				continue;
+			s.ns = all->cur.ns;
+
+			if (!(d = finddisk(name))) {
+				if (!(d = adddisk(name)))
+					return -1;
+				all = &disks[0];
 			}
+			d->cur = s;
+
+			if (d->total)
+				for (j = 0; j < NUMFIELDS; j++)
+					all->cur.val[j] += s.val[j];
 		}
-		free(line);
-		if(ferror(fp)) {
-			warn("getline '/proc/vmstat':");
-			return 1;
+
+		return 0;
+	}
+
+	/* Rate of change per second of a sample field for the given device,
+	 * based on the actual time elapsed between the last two reads. */
+	static int
+	rate(const char *dev, int field, double *res)
+	{
+		struct disk *d;
+
+		if (readstats() < 0)
+			return -1;
+		if (!(d = finddisk(dev ? dev : ""))) {
+			warn("io: unknown device '%s'", dev);
+			return -1;
 		}
- 
-		fclose(fp);
+		if (!d->prev.ns || d->cur.ns <= d->prev.ns)
+			return -1;
+
+		if (d->cur.val[field] < d->prev.val[field])
+			return -1;
+
+		*res = (double)(d->cur.val[field] - d->prev.val[field]) * 1E9 /
+		       (d->cur.ns - d->prev.ns);
 		return 0;
 	}
- 
+
 	const char *
-	io_in(const char *unused)
+	io_in(const char *dev)
 	{
-		uintmax_t oldin;
-		static uintmax_t newin;
- 
-		oldin = newin;
- 
-		if (get_io(&newin, NULL)) {
-			return NULL;
-		}
-		if (oldin == 0) {
+		double sectors;
+
+		if (rate(dev, RD_SECTORS, &sectors) < 0)
 			return NULL;
-		}
- 
-		return fmt_human((newin-oldin) * 1024, 1024);
+
+		return fmt_human(sectors * SECTOR_SIZE, 1024);
 	}
- 
+
 	const char *
-	io_out(const char *unused)
+	io_out(const char *dev)
 	{
-		uintmax_t oldout;
-		static uintmax_t newout;
- 
-		oldout = newout;
- 
-		if (get_io(NULL, &newout)) {
-			return NULL;
-		}
-		if (oldout == 0) {
+		double sectors;
+
+		if (rate(dev, WR_SECTORS, &sectors) < 0)
 			return NULL;
-		}
- 
-		return fmt_human((newout - oldout) * 1024, 1024);
+
+		return fmt_human(sectors * SECTOR_SIZE, 1024);
 	}
- 
+
 	const char *
-	io_perc(const char *unused)
+	io_perc(const char *dev)
 	{
-		struct dirent *dp;
-		DIR *bd;
-		uintmax_t oldwait;
-		static uintmax_t newwait;
-		extern const unsigned int interval;
- 
-		oldwait = newwait;
- 
-		if (!(bd = opendir("/sys/block"))) {
-			warn("opendir '%s':", "/sys/block");
-			return NULL;
-		}
- 
-		newwait = 0;
-		/* get IO wait stats from the /sys/block directories */
-		while ((dp = readdir(bd))) {
-			if (strstr(dp->d_name, "loop") ||
-				strstr(dp->d_name, "ram")) {
-				continue;
-			}
-			if (!strcmp(dp->d_name, ".") ||
-				!strcmp(dp->d_name, "..")) {
-				continue;
-			}
-			/* virtual devices don't count */
-			char virtpath[50];
-			strcpy(virtpath, "/sys/devices/virtual/block/");
-			strcat(virtpath, dp->d_name);
-			if (access(virtpath, R_OK) == 0) {
-				continue;
-			}
-			char statpath[34];
-			strcpy(statpath, "/sys/block/");
-			strcat(statpath, dp->d_name);
-			strcat(statpath, "/stat");
-			uintmax_t partwait;
-			if (pscanf(statpath,
-				"%*d %*d %*d %*d %*d %*d %*d %*d %*d %ju %*d",
-				&partwait) != 1) {
-				continue;
-			}
-			newwait += partwait;
-		}
-		closedir(bd);
-		if (oldwait == 0 || newwait < oldwait) {
+		double ms;
+
+		if (rate(dev, IO_TICKS, &ms) < 0)
 			return NULL;
-		}
- 
-		return bprintf("%0.1f", 100 *
-			   (newwait - oldwait) / (float)interval);
+
+		/* ms of I/O per second of wall time */
+		setnum(ms / 10);
+		return bprintf("%0.1f", ms / 10);
 	}
- 
 #else
 	const char *
 	io_in(const char *unused)
 	{
 		return NULL;
 	}
- 
+
 	const char *
 	io_out(const char *unused)
 	{
 		return NULL;
 	}
- 
+
 	const char *
 	io_perc(const char *unused)
 	{
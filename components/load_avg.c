@@ -5,15 +5,45 @@
 #include "../slstatus.h"
 #include "../util.h"
 
+#if defined(__linux__)
+	#include <sys/sysinfo.h>
+
+	static int
+	getavgs(double avgs[3])
+	{
+		const struct sysinfo *si;
+		int i;
+
+		if (!(si = sysinfo_tick()))
+			return -1;
+		/* fixed point with SI_LOAD_SHIFT fractional bits */
+		for (i = 0; i < 3; i++)
+			avgs[i] = (double)si->loads[i] / (1 << SI_LOAD_SHIFT);
+
+		return 0;
+	}
+#else
+	static int
+	getavgs(double avgs[3])
+	{
+		if (getloadavg(avgs, 3) < 0) {
+			warn("getloadavg: Failed to obtain load average");
+			return -1;
+		}
+
+		return 0;
+	}
+#endif
+
 const char *
 load_avg(const char *unused)
 {
 	double avgs[3];
 
-	if (getloadavg(avgs, 3) < 0) {
-		warn("getloadavg: Failed to obtain load average");
+	if (getavgs(avgs) < 0)
 		return NULL;
-	}
 
+	/* suppression only looks at the one minute average */
+	setnum(avgs[0]);
 	return bprintf("%.2f %.2f %.2f", avgs[0], avgs[1], avgs[2]);
 }
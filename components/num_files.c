@@ -13,6 +13,7 @@ num_files(const char *path)
 	DIR *dir;
 	int num;
 
+	path = rpath(path);
 	if (!(dir = opendir(path))) {
 		warn("opendir '%s':", path);
 		return NULL;
@@ -28,5 +29,5 @@ num_files(const char *path)
 
 	closedir(dir);
 
-	return bprintf("%d", num);
+	return fmt_int(num);
 }
@@ -0,0 +1,159 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../slstatus.h"
+#include "../util.h"
+
+#if defined(__linux__)
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <unistd.h>
+
+	/*
+	 * A pressure file opened for one argument: "some" or "full", optionally
+	 * followed by a trigger, a stall and a window in microseconds as in
+	 * "some 150000 1000000". The kernel flags POLLPRI on a triggered file
+	 * once the tasks stalled longer than that within a window.
+	 */
+	struct psi {
+		char *path;
+		char *arg;
+		char kind[5];
+		int fd;
+		int trigger;
+	};
+
+	static struct psi *psis;
+	static size_t npsis;
+
+	static struct psi *
+	getpsi(const char *path, const char *arg)
+	{
+		struct psi *p;
+		unsigned long stall, window;
+		size_t i;
+		int n;
+
+		for (i = 0; i < npsis; i++)
+			if (!strcmp(psis[i].path, path) && !strcmp(psis[i].arg, arg))
+				return &psis[i];
+
+		if (!(p = realloc(psis, (npsis + 1) * sizeof(*p)))) {
+			warn("realloc:");
+			return NULL;
+		}
+		psis = p;
+		p = &psis[npsis];
+		memset(p, 0, sizeof(*p));
+		if (!(p->path = strdup(path)) || !(p->arg = strdup(arg))) {
+			warn("strdup:");
+			free(p->path);
+			return NULL;
+		}
+		/* failures are kept as well, to warn only once */
+		p->fd = -1;
+		npsis++;
+
+		n = sscanf(arg, "%4s %lu %lu", p->kind, &stall, &window);
+		if (n < 1 || n == 2 || (strcmp(p->kind, "some") && strcmp(p->kind, "full")) ||
+		    (n == 3 && (!stall || stall > window))) {
+			warn("psi: Invalid argument '%s', expected some or full and "
+			     "optionally a stall and window in us", arg);
+			return p;
+		}
+
+		if (n == 3) {
+			/* writing the trigger requires the file to be writable */
+			if ((p->fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC)) < 0 ||
+			    write(p->fd, arg, strlen(arg) + 1) < 0) {
+				warn("psi trigger '%s' on '%s':", arg, path);
+				if (p->fd >= 0)
+					close(p->fd);
+				p->fd = -1;
+			} else {
+				p->trigger = 1;
+			}
+		}
+		if (p->fd < 0 && (p->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+			warn("open '%s':", path);
+
+		return p;
+	}
+
+	static const char *
+	psi(const char *file, const char *arg)
+	{
+		struct psi *p;
+		char text[256], *line;
+		double avg10, avg60;
+		ssize_t n;
+
+		if (!(p = getpsi(rpath(file), arg ? arg : "some")) || p->fd < 0)
+			return NULL;
+
+		if ((n = pread(p->fd, text, sizeof(text) - 1, 0)) < 0) {
+			warn("read '%s':", p->path);
+			return NULL;
+		}
+		text[n] = '\0';
+
+		/* "some avg10=0.00 avg60=0.00 avg300=0.00 total=0" */
+		for (line = text; line && strncmp(line, p->kind, 4); )
+			if ((line = strchr(line, '\n')))
+				line++;
+		if (!line || sscanf(line + 4, " avg10=%lf avg60=%lf",
+		                    &avg10, &avg60) != 2) {
+			warn("psi: No '%s' line in '%s'", p->kind, p->path);
+			return NULL;
+		}
+
+		/*
+		 * The averages decay on their own, so the module is updated on
+		 * its interval until both show as 0.00. Only from then on is it
+		 * left to the kernel to report the next stall.
+		 */
+		if (p->trigger && avg10 < 0.005 && avg60 < 0.005)
+			watchfd(p->fd, POLLPRI);
+
+		setnum(avg10);
+		return bprintf("%.2f %.2f", avg10, avg60);
+	}
+
+	const char *
+	psi_cpu(const char *arg)
+	{
+		return psi("/proc/pressure/cpu", arg);
+	}
+
+	const char *
+	psi_io(const char *arg)
+	{
+		return psi("/proc/pressure/io", arg);
+	}
+
+	const char *
+	psi_mem(const char *arg)
+	{
+		return psi("/proc/pressure/memory", arg);
+	}
+#else
+	const char *
+	psi_cpu(const char *arg)
+	{
+		return NULL;
+	}
+
+	const char *
+	psi_io(const char *arg)
+	{
+		return NULL;
+	}
+
+	const char *
+	psi_mem(const char *arg)
+	{
+		return NULL;
+	}
+#endif
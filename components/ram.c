@@ -41,7 +41,7 @@
 			return NULL;
 
 		percent = 100 * ((total - free) - (buffers + cached)) / total;
-		return bprintf("%d", percent);
+		return fmt_int(percent);
 	}
 
 	const char *
@@ -139,7 +139,7 @@
 			return NULL;
 
 		percent = uvmexp.active * 100 / uvmexp.npages;
-		return bprintf("%d", percent);
+		return fmt_int(percent);
 	}
 
 	const char *
@@ -213,7 +213,7 @@
 		                 &active, &len, NULL, 0) < 0 || !len)
 			return NULL;
 
-		return bprintf("%d", active * 100 / npages);
+		return fmt_int(active * 100 / npages);
 	}
 
 	const char *
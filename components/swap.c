@@ -29,8 +29,8 @@
 			if (ent[i].var)
 				left++;
 
-		if (!(fp = fopen("/proc/meminfo", "r"))) {
-			warn("fopen '/proc/meminfo':");
+		if (!(fp = fopen(rpath("/proc/meminfo"), "r"))) {
+			warn("fopen '%s':", rpath("/proc/meminfo"));
 			return 1;
 		}
 
@@ -75,7 +75,7 @@
 		if (get_swap_info(&total, &free, &cached) || total == 0)
 			return NULL;
 
-		return bprintf("%d", 100 * (total - free - cached) / total);
+		return fmt_int(100 * (total - free - cached) / total);
 	}
 
 	const char *
@@ -163,7 +163,7 @@
 		if (total == 0)
 			return NULL;
 
-		return bprintf("%d", 100 * used / total);
+		return fmt_int(100 * used / total);
 	}
 
 	const char *
@@ -241,7 +241,7 @@
 		total = swap_info[0].ksw_total;
 		used = swap_info[0].ksw_used;
 
-		return bprintf("%d", used * 100 / total);
+		return fmt_int(used * 100 / total);
 	}
 
 	const char *
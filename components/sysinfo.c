@@ -0,0 +1,199 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../slstatus.h"
+#include "../util.h"
+
+#if defined(__linux__)
+	#include <sys/sysinfo.h>
+
+	/*
+	 * One sysinfo(2) per tick serves the modules below as well as uptime
+	 * and load_avg, without reading or parsing any file.
+	 */
+	const struct sysinfo *
+	sysinfo_tick(void)
+	{
+		static struct sysinfo si;
+		static unsigned int lasttick;
+		static int valid;
+
+		if (valid && lasttick == tick)
+			return &si;
+
+		if (sysinfo(&si) < 0) {
+			warn("sysinfo:");
+			valid = 0;
+			return NULL;
+		}
+		lasttick = tick;
+		valid = 1;
+
+		return &si;
+	}
+
+	static uintmax_t
+	bytes(const struct sysinfo *si, unsigned long n)
+	{
+		return (uintmax_t)n * (si->mem_unit ? si->mem_unit : 1);
+	}
+
+	const char *
+	si_ram_free(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()))
+			return NULL;
+
+		return fmt_human(bytes(si, si->freeram), 1024);
+	}
+
+	const char *
+	si_ram_perc(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()) || si->totalram == 0)
+			return NULL;
+
+		/* the page cache is not reported, it counts as used */
+		return fmt_int(100 * bytes(si, si->totalram - si->freeram -
+		                           si->bufferram) / bytes(si, si->totalram));
+	}
+
+	const char *
+	si_ram_total(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()))
+			return NULL;
+
+		return fmt_human(bytes(si, si->totalram), 1024);
+	}
+
+	const char *
+	si_ram_used(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()))
+			return NULL;
+
+		return fmt_human(bytes(si, si->totalram - si->freeram -
+		                       si->bufferram), 1024);
+	}
+
+	const char *
+	si_swap_free(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()))
+			return NULL;
+
+		return fmt_human(bytes(si, si->freeswap), 1024);
+	}
+
+	const char *
+	si_swap_perc(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()) || si->totalswap == 0)
+			return NULL;
+
+		return fmt_int(100 * bytes(si, si->totalswap - si->freeswap) /
+		               bytes(si, si->totalswap));
+	}
+
+	const char *
+	si_swap_total(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()))
+			return NULL;
+
+		return fmt_human(bytes(si, si->totalswap), 1024);
+	}
+
+	const char *
+	si_swap_used(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()))
+			return NULL;
+
+		return fmt_human(bytes(si, si->totalswap - si->freeswap), 1024);
+	}
+
+	const char *
+	procs(const char *unused)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()))
+			return NULL;
+
+		return fmt_int(si->procs);
+	}
+#else
+	/* sysinfo(2) is Linux only, the regular modules are used instead */
+	const char *
+	si_ram_free(const char *unused)
+	{
+		return ram_free(unused);
+	}
+
+	const char *
+	si_ram_perc(const char *unused)
+	{
+		return ram_perc(unused);
+	}
+
+	const char *
+	si_ram_total(const char *unused)
+	{
+		return ram_total(unused);
+	}
+
+	const char *
+	si_ram_used(const char *unused)
+	{
+		return ram_used(unused);
+	}
+
+	const char *
+	si_swap_free(const char *unused)
+	{
+		return swap_free(unused);
+	}
+
+	const char *
+	si_swap_perc(const char *unused)
+	{
+		return swap_perc(unused);
+	}
+
+	const char *
+	si_swap_total(const char *unused)
+	{
+		return swap_total(unused);
+	}
+
+	const char *
+	si_swap_used(const char *unused)
+	{
+		return swap_used(unused);
+	}
+
+	const char *
+	procs(const char *unused)
+	{
+		return NULL;
+	}
+#endif
@@ -16,7 +16,7 @@
 		if (pscanf(file, "%ju", &temp) != 1)
 			return NULL;
 
-		return bprintf("%ju", temp / 1000);
+		return fmt_int(temp / 1000);
 	}
 #elif defined(__OpenBSD__)
 	#include <stdio.h>
@@ -45,7 +45,7 @@
 		}
 
 		/* kelvin to celsius */
-		return bprintf("%d", (int)((float)(temp.value-273150000) / 1E6));
+		return fmt_int((int)((float)(temp.value-273150000) / 1E6));
 	}
 #elif defined(__FreeBSD__)
 	#include <stdio.h>
@@ -68,6 +68,7 @@
 			return NULL;
 
 		/* kelvin to decimal celcius */
+		setnum((temp - 2731) / 10.0);
 		return bprintf("%d.%d", (temp - 2731) / 10, abs((temp - 2731) % 10));
 	}
 #endif
@@ -0,0 +1,311 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../slstatus.h"
+#include "../util.h"
+
+#define TOP_MAX 10 /* most processes a top_proc module lists */
+
+#if defined(__linux__)
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <limits.h>
+	#include <stdint.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <sys/resource.h>
+
+	struct proc {
+		int pid;
+		unsigned long long ticks; /* utime + stime */
+		unsigned long long delta; /* ticks since the previous scan */
+		unsigned long long rss;   /* in bytes */
+		int fd;
+		char comm[16];
+	};
+
+	/* pid to ticks of the previous scan, open addressing */
+	struct slot {
+		int pid; /* 0 for an empty slot */
+		int fd;  /* /proc/<pid>/stat kept open, or -1 */
+		unsigned long long ticks;
+	};
+
+	static struct proc *entries;
+	static size_t nentries, entriessize;
+	static struct slot *table;
+	static size_t tablesize;
+	static size_t nfds, maxfds;
+	static unsigned long long elapsed; /* ns between the last two scans */
+
+	static size_t
+	hash(int pid, size_t size)
+	{
+		return ((uint32_t)pid * 2654435761u) & (size - 1);
+	}
+
+	static struct slot *
+	lookup(struct slot *t, size_t size, int pid)
+	{
+		size_t i;
+
+		if (!t)
+			return NULL;
+		for (i = hash(pid, size); t[i].pid; i = (i + 1) & (size - 1))
+			if (t[i].pid == pid)
+				return &t[i];
+
+		return NULL;
+	}
+
+	/*
+	 * Reads the stat of a process, through the fd kept from the previous
+	 * scan if there is one. Reading an exited process fails even if its
+	 * pid was reused, so that needs no special care.
+	 */
+	static ssize_t
+	readstat(DIR *dir, const char *pid, int *fd, char *text, size_t size)
+	{
+		char path[PATH_MAX];
+		ssize_t n;
+
+		if (*fd >= 0) {
+			if ((n = pread(*fd, text, size, 0)) > 0)
+				return n;
+			close(*fd);
+			*fd = -1;
+			nfds--;
+		}
+
+		snprintf(path, sizeof(path), "%s/stat", pid);
+		if ((*fd = openat(dirfd(dir), path, O_RDONLY | O_CLOEXEC)) < 0)
+			return -1; /* exited in the meantime */
+		n = read(*fd, text, size);
+		if (nfds < maxfds) {
+			nfds++;
+		} else {
+			close(*fd);
+			*fd = -1;
+		}
+
+		return n;
+	}
+
+	/* Parses /proc/<pid>/stat, the comm may contain spaces and parens */
+	static int
+	parsestat(char *text, struct proc *p)
+	{
+		char *s, *e;
+		int field;
+
+		if (!(s = strchr(text, '(')) || !(e = strrchr(text, ')')))
+			return -1;
+		snprintf(p->comm, sizeof(p->comm), "%.*s", (int)(e - s - 1), s + 1);
+
+		/* state is field 3, utime 14, stime 15 and rss 24 */
+		for (s = e + 2, field = 3; *s && field <= 24; field++) {
+			if (field == 14)
+				p->ticks = strtoull(s, NULL, 10);
+			else if (field == 15)
+				p->ticks += strtoull(s, NULL, 10);
+			else if (field == 24)
+				p->rss = strtoull(s, NULL, 10);
+			if (!(s = strchr(s, ' ')))
+				break;
+			s++;
+		}
+
+		return field > 24 ? 0 : -1;
+	}
+
+	/*
+	 * Reads the stat of every process once per tick for all top_proc
+	 * modules. The ticks of the previous scan are looked up by pid, the
+	 * table is rebuilt from the processes found so the dead drop out.
+	 * Opening the stat files takes as long as reading them, so up to half
+	 * of the allowed fds are kept open.
+	 */
+	static int
+	scan(void)
+	{
+		static DIR *dir;
+		static unsigned int lasttick;
+		static unsigned long long last;
+		static long pagesize;
+		struct dirent *de;
+		struct proc *p;
+		struct slot *new, *s, *old;
+		struct rlimit rl;
+		struct timespec ts;
+		unsigned long long now;
+		char text[1024];
+		ssize_t n;
+		size_t i, size;
+		int fd;
+
+		if (dir && lasttick == tick)
+			return 0;
+
+		if (!dir) {
+			if (!(dir = opendir(rpath("/proc")))) {
+				warn("opendir '%s':", rpath("/proc"));
+				return -1;
+			}
+			pagesize = sysconf(_SC_PAGESIZE);
+			if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+				maxfds = rl.rlim_cur / 2;
+			else
+				maxfds = 512;
+		} else {
+			rewinddir(dir);
+		}
+		lasttick = tick;
+
+		for (nentries = 0; (de = readdir(dir)); ) {
+			if (de->d_name[0] < '1' || de->d_name[0] > '9')
+				continue;
+			if (nentries == entriessize) {
+				if (!(p = realloc(entries, (entriessize + 256) * sizeof(*p)))) {
+					warn("realloc:");
+					break;
+				}
+				entries = p;
+				entriessize += 256;
+			}
+			p = &entries[nentries];
+			p->pid = atoi(de->d_name);
+
+			/* the fd moves to the new table below */
+			fd = -1;
+			if ((old = lookup(table, tablesize, p->pid))) {
+				fd = old->fd;
+				old->fd = -1;
+			}
+			n = readstat(dir, de->d_name, &fd, text, sizeof(text) - 1);
+			p->fd = fd;
+			if (n <= 0)
+				goto skip;
+			text[n] = '\0';
+			if (parsestat(text, p) < 0)
+				goto skip;
+			p->rss *= pagesize;
+			p->delta = (old && p->ticks >= old->ticks) ? p->ticks - old->ticks : 0;
+			nentries++;
+			continue;
+		skip:
+			if (fd >= 0) {
+				close(fd);
+				nfds--;
+			}
+		}
+
+		/* at most half full */
+		for (size = 64; size < nentries * 2; size *= 2)
+			;
+		if (!(new = calloc(size, sizeof(*new)))) {
+			warn("calloc:");
+			return -1;
+		}
+		for (i = 0; i < nentries; i++) {
+			p = &entries[i];
+			for (s = &new[hash(p->pid, size)]; s->pid;
+			     s = &new[(s - new + 1) & (size - 1)])
+				;
+			s->pid = p->pid;
+			s->fd = p->fd;
+			s->ticks = p->ticks;
+		}
+		/* what is left belongs to processes that exited */
+		for (i = 0; i < tablesize; i++) {
+			if (table[i].pid && table[i].fd >= 0) {
+				close(table[i].fd);
+				nfds--;
+			}
+		}
+		free(table);
+		table = new;
+		tablesize = size;
+
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+			warn("clock_gettime:");
+			return -1;
+		}
+		now = (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+		elapsed = last ? now - last : 0;
+		last = now;
+
+		return 0;
+	}
+
+	/*
+	 * The processes using the most cpu since the previous tick (in percent
+	 * of one cpu, as top) or memory. The argument is cpu or mem and how many
+	 * to list, "cpu 3"; just the top one by cpu if left out.
+	 */
+	const char *
+	top_proc(const char *arg)
+	{
+		static long hz;
+		struct proc *top[TOP_MAX], *p;
+		char kind[4] = "cpu", out[sizeof(buf)];
+		const char *val;
+		size_t i, j, len;
+		int n = 1, mem;
+
+		if (arg && sscanf(arg, "%3s %d", kind, &n) < 1)
+			n = 1;
+		if ((mem = !strcmp(kind, "mem")) == 0 && strcmp(kind, "cpu")) {
+			warn("top_proc: Invalid argument '%s', expected cpu or mem "
+			     "and a count", arg);
+			return NULL;
+		}
+		if (n < 1 || n > TOP_MAX)
+			n = (n < 1) ? 1 : TOP_MAX;
+		if (!hz)
+			hz = sysconf(_SC_CLK_TCK);
+
+		if (scan() < 0 || (!mem && !elapsed) || !nentries)
+			return NULL;
+
+		/* keep the n largest, sorted */
+		for (i = 0, len = 0; i < nentries; i++) {
+			p = &entries[i];
+			for (j = len; j > 0 && (mem ? p->rss > top[j - 1]->rss :
+			                            p->delta > top[j - 1]->delta); j--)
+				if (j < (size_t)n)
+					top[j] = top[j - 1];
+			if (j < (size_t)n) {
+				top[j] = p;
+				if (len < (size_t)n)
+					len++;
+			}
+		}
+
+		for (i = 0, out[0] = '\0'; i < len; i++) {
+			p = top[i];
+			if (mem)
+				val = fmt_human(p->rss, 1024);
+			else
+				val = fmt_int(p->delta * 100 * 1000000000ULL / hz / elapsed);
+			if (esnprintf(out + strlen(out), sizeof(out) - strlen(out),
+			              "%s%s %s%s", i ? ", " : "", p->comm, val,
+			              mem ? "" : "%") < 0)
+				break;
+		}
+		/* the numeric value is that of the top process */
+		if (mem)
+			setnum(top[0]->rss);
+		else
+			setnum(top[0]->delta * 100 * 1000000000ULL / hz / elapsed);
+
+		return bprintf("%s", out);
+	}
+#else
+	const char *
+	top_proc(const char *arg)
+	{
+		return NULL;
+	}
+#endif
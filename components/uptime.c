@@ -6,29 +6,56 @@
 #include "../slstatus.h"
 #include "../util.h"
 
-#if defined(CLOCK_BOOTTIME)
-	#define UPTIME_FLAG CLOCK_BOOTTIME
-#elif defined(CLOCK_UPTIME)
-	#define UPTIME_FLAG CLOCK_UPTIME
+#if defined(__linux__)
+	#include <sys/sysinfo.h>
+
+	static int
+	getuptime(uintmax_t *secs)
+	{
+		const struct sysinfo *si;
+
+		if (!(si = sysinfo_tick()))
+			return -1;
+		*secs = si->uptime;
+
+		return 0;
+	}
 #else
-	#define UPTIME_FLAG CLOCK_MONOTONIC
+	#if defined(CLOCK_BOOTTIME)
+		#define UPTIME_FLAG CLOCK_BOOTTIME
+	#elif defined(CLOCK_UPTIME)
+		#define UPTIME_FLAG CLOCK_UPTIME
+	#else
+		#define UPTIME_FLAG CLOCK_MONOTONIC
+	#endif
+
+	static int
+	getuptime(uintmax_t *secs)
+	{
+		char warn_buf[256];
+		struct timespec uptime;
+
+		if (clock_gettime(UPTIME_FLAG, &uptime) < 0) {
+			snprintf(warn_buf, sizeof(warn_buf), "clock_gettime %d", UPTIME_FLAG);
+			warn(warn_buf);
+			return -1;
+		}
+		*secs = uptime.tv_sec;
+
+		return 0;
+	}
 #endif
 
 const char *
 uptime(const char *unused)
 {
-	char warn_buf[256];
-	uintmax_t h, m;
-	struct timespec uptime;
+	uintmax_t secs, h, m;
 
-	if (clock_gettime(UPTIME_FLAG, &uptime) < 0) {
-		snprintf(warn_buf, sizeof(warn_buf), "clock_gettime %d", UPTIME_FLAG);
-		warn(warn_buf);
+	if (getuptime(&secs) < 0)
 		return NULL;
-	}
 
-	h = uptime.tv_sec / 3600;
-	m = uptime.tv_sec % 3600 / 60;
+	h = secs / 3600;
+	m = secs % 3600 / 60;
 
 	return bprintf("%juh %jum", h, m);
 }
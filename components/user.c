@@ -10,7 +10,7 @@
 const char *
 gid(const char *unused)
 {
-	return bprintf("%d", getgid());
+	return fmt_int(getgid());
 }
 
 const char *
@@ -29,5 +29,5 @@ username(const char *unused)
 const char *
 uid(const char *unused)
 {
-	return bprintf("%d", geteuid());
+	return fmt_int(geteuid());
 }
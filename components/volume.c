@@ -177,7 +177,7 @@
 			}
 		}
 
-		return bprintf("%d", value);
+		return fmt_int(value);
 	}
  #elif defined(ALSA)
 	#include <alsa/asoundlib.h>
@@ -232,7 +232,11 @@
 		snd_mixer_detach(mixer, devname);
 		snd_mixer_close(mixer);
 
-		return volume == -1 ? NULL : bprintf("%.0f", (volume-min)*100./(max-min));
+		if (volume == -1)
+			return NULL;
+
+		setnum((volume-min)*100./(max-min));
+		return bprintf("%.0f", (volume-min)*100./(max-min));
 	}
 #else
 	#include <sys/soundcard.h>
@@ -266,6 +270,6 @@
 
 		close(afd);
 
-		return bprintf("%d", v & 0xff);
+		return fmt_int(v & 0xff);
 	}
 #endif
@@ -15,13 +15,327 @@
 			(2 * (rssi + 100)))
 
 #if defined(__linux__)
+	#include <errno.h>
 	#include <limits.h>
+	#include <net/if.h>
+	#include <poll.h>
+	#include <stdint.h>
+	#include <stdlib.h>
+	#include <linux/genetlink.h>
+	#include <linux/netlink.h>
+	#include <linux/nl80211.h>
 	#include <linux/wireless.h>
 
 	#define NET_OPERSTATE "/sys/class/net/%s/operstate"
 
-	const char *
-	wifi_perc(const char *interface)
+	#define ATTRDATA(a) ((char *)(a) + NLA_HDRLEN)
+	#define ATTRLEN(a)  ((int)(a)->nla_len - NLA_HDRLEN)
+
+	/* What nl80211 reports for an interface, sampled once per tick */
+	struct wifi {
+		char name[IF_NAMESIZE];
+		unsigned int ifindex; /* 0 until resolved */
+		unsigned int tick;
+		int sampled;
+		int connected;
+		char ssid[IW_ESSID_MAX_SIZE + 1];
+		int signal;           /* in dBm */
+		uint32_t tx, rx;      /* bitrates in 100 kbit/s */
+	};
+
+	static struct wifi *wifis;
+	static size_t nwifis;
+	static int nlfd = -2;  /* requests, -2 unopened */
+	static int evfd = -1;  /* connect and disconnect events */
+	static uint16_t family;
+	static uint32_t seq;
+	static char nlbuf[32768];
+
+	/* Sends a generic netlink request carrying one attribute */
+	static int
+	nlsend(uint16_t type, uint16_t flags, uint8_t cmd, uint16_t attr,
+	       const void *data, uint16_t len)
+	{
+		struct {
+			struct nlmsghdr nh;
+			struct genlmsghdr gh;
+			char attrs[64];
+		} req;
+		struct nlattr *a;
+
+		memset(&req, 0, sizeof(req));
+		a = (struct nlattr *)req.attrs;
+		a->nla_type = attr;
+		a->nla_len = NLA_HDRLEN + len;
+		memcpy(ATTRDATA(a), data, len);
+		req.nh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + NLA_ALIGN(a->nla_len));
+		req.nh.nlmsg_type = type;
+		req.nh.nlmsg_flags = NLM_F_REQUEST | flags;
+		req.nh.nlmsg_seq = ++seq;
+		req.gh.cmd = cmd;
+		req.gh.version = 1;
+
+		if (send(nlfd, &req, req.nh.nlmsg_len, 0) < 0) {
+			warn("send 'NETLINK_GENERIC':");
+			return -1;
+		}
+
+		return 0;
+	}
+
+	/*
+	 * Hands the attributes of every reply to the request to cb, until the
+	 * last part of a dump. Errors are returned in errno.
+	 */
+	static int
+	nlrecv(void (*cb)(char *, int, void *), void *arg)
+	{
+		struct nlmsghdr *nh;
+		struct nlmsgerr *err;
+		ssize_t n;
+		int len;
+
+		for (;;) {
+			if ((n = recv(nlfd, nlbuf, sizeof(nlbuf), 0)) < 0) {
+				if (errno == EINTR)
+					continue;
+				warn("recv 'NETLINK_GENERIC':");
+				return -1;
+			}
+			for (nh = (struct nlmsghdr *)nlbuf; NLMSG_OK(nh, n);
+			     nh = NLMSG_NEXT(nh, n)) {
+				if (nh->nlmsg_seq != seq)
+					continue;
+				if (nh->nlmsg_type == NLMSG_DONE)
+					return 0;
+				if (nh->nlmsg_type == NLMSG_ERROR) {
+					err = NLMSG_DATA(nh);
+					errno = -err->error;
+					return err->error ? -1 : 0;
+				}
+				len = nh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+				if (len >= 0)
+					cb((char *)NLMSG_DATA(nh) + GENL_HDRLEN, len, arg);
+				if (!(nh->nlmsg_flags & NLM_F_MULTI))
+					return 0;
+			}
+		}
+	}
+
+	/* Indexes the attributes in data by type, up to max */
+	static void
+	parseattrs(struct nlattr **tb, int max, char *data, int len)
+	{
+		struct nlattr *a;
+
+		memset(tb, 0, (max + 1) * sizeof(*tb));
+		for (a = (struct nlattr *)data; len >= NLA_HDRLEN &&
+		     a->nla_len >= NLA_HDRLEN && a->nla_len <= len;
+		     len -= NLA_ALIGN(a->nla_len),
+		     a = (struct nlattr *)((char *)a + NLA_ALIGN(a->nla_len)))
+			if ((a->nla_type & NLA_TYPE_MASK) <= max)
+				tb[a->nla_type & NLA_TYPE_MASK] = a;
+	}
+
+	struct ctrlinfo {
+		uint16_t family;
+		uint32_t mlme;
+	};
+
+	/* The family id of nl80211 and its group of (dis)connect events */
+	static void
+	onfamily(char *data, int len, void *arg)
+	{
+		struct ctrlinfo *ci = arg;
+		struct nlattr *tb[CTRL_ATTR_MAX + 1], *g[CTRL_ATTR_MCAST_GRP_MAX + 1];
+		struct nlattr *a;
+		int rem;
+
+		parseattrs(tb, CTRL_ATTR_MAX, data, len);
+		if (tb[CTRL_ATTR_FAMILY_ID])
+			memcpy(&ci->family, ATTRDATA(tb[CTRL_ATTR_FAMILY_ID]),
+			       sizeof(ci->family));
+		if (!(a = tb[CTRL_ATTR_MCAST_GROUPS]))
+			return;
+
+		rem = ATTRLEN(a);
+		for (a = (struct nlattr *)ATTRDATA(a); rem >= NLA_HDRLEN &&
+		     a->nla_len >= NLA_HDRLEN && a->nla_len <= rem;
+		     rem -= NLA_ALIGN(a->nla_len),
+		     a = (struct nlattr *)((char *)a + NLA_ALIGN(a->nla_len))) {
+			parseattrs(g, CTRL_ATTR_MCAST_GRP_MAX, ATTRDATA(a), ATTRLEN(a));
+			if (g[CTRL_ATTR_MCAST_GRP_NAME] && g[CTRL_ATTR_MCAST_GRP_ID] &&
+			    !strcmp(ATTRDATA(g[CTRL_ATTR_MCAST_GRP_NAME]),
+			            NL80211_MULTICAST_GROUP_MLME))
+				memcpy(&ci->mlme, ATTRDATA(g[CTRL_ATTR_MCAST_GRP_ID]),
+				       sizeof(ci->mlme));
+		}
+	}
+
+	/*
+	 * Opens the request socket kept for all wifi modules and resolves
+	 * nl80211 once. Without it, as on kernels built without cfg80211,
+	 * the wireless extensions are used instead.
+	 */
+	static int
+	nlopen(void)
+	{
+		struct ctrlinfo ci = { 0 };
+		struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+		int fd;
+
+		if (nlfd != -2)
+			return nlfd;
+
+		if ((nlfd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC,
+		                   NETLINK_GENERIC)) < 0) {
+			warn("socket 'NETLINK_GENERIC':");
+			return nlfd = -1;
+		}
+		if (nlsend(GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+		           NL80211_GENL_NAME, sizeof(NL80211_GENL_NAME)) < 0 ||
+		    nlrecv(onfamily, &ci) < 0 || !ci.family) {
+			warn("nl80211: Not available, using wireless extensions");
+			close(nlfd);
+			return nlfd = -1;
+		}
+		family = ci.family;
+
+		/* without events the ESSID is polled like the rest */
+		if (!ci.mlme)
+			return nlfd;
+		if ((fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK,
+		                 NETLINK_GENERIC)) < 0 ||
+		    bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+		    setsockopt(fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &ci.mlme,
+		               sizeof(ci.mlme)) < 0) {
+			warn("nl80211: Cannot join '%s' group:",
+			     NL80211_MULTICAST_GROUP_MLME);
+			if (fd >= 0)
+				close(fd);
+			return nlfd;
+		}
+		evfd = fd;
+
+		return nlfd;
+	}
+
+	static void
+	oninterface(char *data, int len, void *arg)
+	{
+		struct wifi *w = arg;
+		struct nlattr *tb[NL80211_ATTR_MAX + 1];
+		int n;
+
+		parseattrs(tb, NL80211_ATTR_MAX, data, len);
+		if (!tb[NL80211_ATTR_SSID])
+			return;
+		n = ATTRLEN(tb[NL80211_ATTR_SSID]);
+		if (n > IW_ESSID_MAX_SIZE)
+			n = IW_ESSID_MAX_SIZE;
+		memcpy(w->ssid, ATTRDATA(tb[NL80211_ATTR_SSID]), n);
+		w->ssid[n] = '\0';
+	}
+
+	/* In 100 kbit/s, the 16 bit attribute overflows above 6.5 Gbit/s */
+	static uint32_t
+	bitrate(struct nlattr *a)
+	{
+		struct nlattr *tb[NL80211_RATE_INFO_MAX + 1];
+		uint32_t rate32;
+		uint16_t rate16;
+
+		if (!a)
+			return 0;
+		parseattrs(tb, NL80211_RATE_INFO_MAX, ATTRDATA(a), ATTRLEN(a));
+		if (tb[NL80211_RATE_INFO_BITRATE32]) {
+			memcpy(&rate32, ATTRDATA(tb[NL80211_RATE_INFO_BITRATE32]),
+			       sizeof(rate32));
+			return rate32;
+		}
+		if (tb[NL80211_RATE_INFO_BITRATE]) {
+			memcpy(&rate16, ATTRDATA(tb[NL80211_RATE_INFO_BITRATE]),
+			       sizeof(rate16));
+			return rate16;
+		}
+
+		return 0;
+	}
+
+	/* A managed interface has one station, the access point */
+	static void
+	onstation(char *data, int len, void *arg)
+	{
+		struct wifi *w = arg;
+		struct nlattr *tb[NL80211_ATTR_MAX + 1];
+		struct nlattr *si[NL80211_STA_INFO_MAX + 1];
+
+		parseattrs(tb, NL80211_ATTR_MAX, data, len);
+		if (!tb[NL80211_ATTR_STA_INFO])
+			return;
+		parseattrs(si, NL80211_STA_INFO_MAX, ATTRDATA(tb[NL80211_ATTR_STA_INFO]),
+		           ATTRLEN(tb[NL80211_ATTR_STA_INFO]));
+		w->connected = 1;
+		if (si[NL80211_STA_INFO_SIGNAL])
+			w->signal = *(int8_t *)ATTRDATA(si[NL80211_STA_INFO_SIGNAL]);
+		w->tx = bitrate(si[NL80211_STA_INFO_TX_BITRATE]);
+		w->rx = bitrate(si[NL80211_STA_INFO_RX_BITRATE]);
+	}
+
+	/*
+	 * Asks nl80211 once per tick for the ESSID and the station of the
+	 * interface, for all modules showing it. Nothing is reported when
+	 * the interface is missing or not associated.
+	 */
+	static struct wifi *
+	sample(const char *interface)
+	{
+		struct wifi *w;
+		size_t i;
+
+		for (i = 0, w = NULL; i < nwifis; i++)
+			if (!strcmp(wifis[i].name, interface))
+				w = &wifis[i];
+		if (!w) {
+			if (!(w = realloc(wifis, (nwifis + 1) * sizeof(*w)))) {
+				warn("realloc:");
+				return NULL;
+			}
+			wifis = w;
+			w = &wifis[nwifis++];
+			memset(w, 0, sizeof(*w));
+			if (esnprintf(w->name, sizeof(w->name), "%s", interface) < 0)
+				return NULL;
+		}
+		if (w->sampled && w->tick == tick)
+			return w;
+		w->sampled = 1;
+		w->tick = tick;
+		w->connected = 0;
+		w->ssid[0] = '\0';
+
+		/* the interface may come and go, e.g. a USB adapter */
+		if (!w->ifindex && !(w->ifindex = if_nametoindex(interface)))
+			return w;
+		if (nlsend(family, 0, NL80211_CMD_GET_INTERFACE,
+		           NL80211_ATTR_IFINDEX, &w->ifindex, sizeof(w->ifindex)) < 0 ||
+		    nlrecv(oninterface, w) < 0) {
+			if (errno == ENODEV)
+				w->ifindex = 0;
+			else
+				warn("nl80211: Interface '%s':", interface);
+			return w;
+		}
+		if (nlsend(family, NLM_F_DUMP, NL80211_CMD_GET_STATION,
+		           NL80211_ATTR_IFINDEX, &w->ifindex, sizeof(w->ifindex)) < 0 ||
+		    nlrecv(onstation, w) < 0)
+			warn("nl80211: Station of '%s':", interface);
+
+		return w;
+	}
+
+	static const char *
+	wext_perc(const char *interface)
 	{
 		int cur;
 		size_t i;
@@ -32,8 +346,8 @@
 
 		if (esnprintf(path, sizeof(path), NET_OPERSTATE, interface) < 0)
 			return NULL;
-		if (!(fp = fopen(path, "r"))) {
-			warn("fopen '%s':", path);
+		if (!(fp = fopen(rpath(path), "r"))) {
+			warn("fopen '%s':", rpath(path));
 			return NULL;
 		}
 		p = fgets(status, 5, fp);
@@ -41,8 +355,8 @@
 		if (!p || strcmp(status, "up\n") != 0)
 			return NULL;
 
-		if (!(fp = fopen("/proc/net/wireless", "r"))) {
-			warn("fopen '/proc/net/wireless':");
+		if (!(fp = fopen(rpath("/proc/net/wireless"), "r"))) {
+			warn("fopen '%s':", rpath("/proc/net/wireless"));
 			return NULL;
 		}
 
@@ -62,11 +376,11 @@
 		       "%*d\t\t%*d\t\t %*d\t  %*d\t\t %*d", &cur);
 
 		/* 70 is the max of /proc/net/wireless */
-		return bprintf("%d", (int)((float)cur / 70 * 100));
+		return fmt_int((int)((float)cur / 70 * 100));
 	}
 
-	const char *
-	wifi_essid(const char *interface)
+	static const char *
+	wext_essid(const char *interface)
 	{
 		static char id[IW_ESSID_MAX_SIZE+1];
 		int sockfd;
@@ -96,6 +410,76 @@
 
 		return id;
 	}
+
+	const char *
+	wifi_perc(const char *interface)
+	{
+		struct wifi *w;
+
+		if (nlopen() < 0)
+			return wext_perc(interface);
+		if (!(w = sample(interface)) || !w->connected)
+			return NULL;
+
+		return fmt_int(RSSI_TO_PERC(w->signal));
+	}
+
+	/*
+	 * Updated when the kernel reports a connect or disconnect rather
+	 * than on an interval, while the events can be received.
+	 */
+	const char *
+	wifi_essid(const char *interface)
+	{
+		struct wifi *w;
+
+		if (nlopen() < 0)
+			return wext_essid(interface);
+		if (evfd >= 0) {
+			while (recv(evfd, nlbuf, sizeof(nlbuf), 0) > 0)
+				;
+			watchfd(evfd, POLLIN);
+		}
+		if (!(w = sample(interface)) || !w->ssid[0])
+			return NULL;
+
+		return bprintf("%s", w->ssid);
+	}
+
+	const char *
+	wifi_signal(const char *interface)
+	{
+		struct wifi *w;
+
+		if (nlopen() < 0 || !(w = sample(interface)) || !w->connected)
+			return NULL;
+
+		return fmt_int(w->signal);
+	}
+
+	const char *
+	wifi_rx_bitrate(const char *interface)
+	{
+		struct wifi *w;
+
+		if (nlopen() < 0 || !(w = sample(interface)) || !w->connected ||
+		    !w->rx)
+			return NULL;
+
+		return fmt_human((uintmax_t)w->rx * 100000, 1000);
+	}
+
+	const char *
+	wifi_tx_bitrate(const char *interface)
+	{
+		struct wifi *w;
+
+		if (nlopen() < 0 || !(w = sample(interface)) || !w->connected ||
+		    !w->tx)
+			return NULL;
+
+		return fmt_human((uintmax_t)w->tx * 100000, 1000);
+	}
 #elif defined(__OpenBSD__)
 	#include <net/if.h>
 	#include <net/if_media.h>
@@ -153,7 +537,7 @@
 			else
 				q = RSSI_TO_PERC(nr.nr_rssi);
 
-			return bprintf("%d", q);
+			return fmt_int(q);
 		}
 
 		return NULL;
@@ -227,7 +611,7 @@
 				rssi_dbm = info.sta.info[0].isi_noise +
  					         info.sta.info[0].isi_rssi / 2;
 
-				fmt = bprintf("%d", RSSI_TO_PERC(rssi_dbm));
+				fmt = fmt_int(RSSI_TO_PERC(rssi_dbm));
 			}
 		}
 
@@ -265,3 +649,24 @@
 		return fmt;
 	}
 #endif
+
+#if !defined(__linux__)
+	/* the station details come from nl80211, which is Linux only */
+	const char *
+	wifi_rx_bitrate(const char *interface)
+	{
+		return NULL;
+	}
+
+	const char *
+	wifi_signal(const char *interface)
+	{
+		return NULL;
+	}
+
+	const char *
+	wifi_tx_bitrate(const char *interface)
+	{
+		return NULL;
+	}
+#endif
@@ -1,13 +1,28 @@
 #include <libconfig.h>
 
+#ifndef PATH_MAX
 #define PATH_MAX 4080
+#endif
 const char *progname = "slstatus";
 
 static char *unknown_string = NULL;
 static int num_modules = 0;
-static struct arg *modules = NULL;
+static struct module *modules = NULL;
+static int num_targets = 0;
+static struct target *targets = NULL;
 int maximum_status_length = MAXLEN;
 
+static int statistics = 0;
+static char *statistics_file = NULL;
+static char *batch_command = NULL;
+static char *shm_name = NULL;
+static int num_queries = 0;
+static struct query *queries = NULL;
+static char *dusk_events = NULL;
+
+unsigned int disk_timeout = 500;
+int disk_total_on_mount_change = 0;
+
 #if HAVE_MPD
 #ifndef MPD_TITLE_LENGTH
 #define MPD_TITLE_LENGTH 20
@@ -32,18 +47,27 @@ int config_setting_lookup_strdup(const config_setting_t *cfg, const char *name,
 int config_lookup_unsigned_int(const config_t *cfg, const char *name, unsigned int *ptr);
 int config_setting_lookup_unsigned_int(const config_setting_t *cfg, const char *name, unsigned int *ptr);
 int config_setting_get_unsigned_int(const config_setting_t *cfg_item, unsigned int *ptr);
+int config_setting_lookup_number(const config_setting_t *cfg, const char *name, double *ptr);
 
 void cleanup_config(void);
-void load_config(void);
+void reset_options(void);
+void free_modules(struct module *modules, int num_modules);
+void free_targets(struct target *targets, int num_targets);
+int load_config(void);
 void load_fallback_config(void);
 void load_modules(config_t *cfg);
+void load_targets(config_t *cfg);
+int parse_statuses(struct target *t, const char *string);
+void load_dusk(config_t *cfg);
+void free_queries(struct query *queries, int num_queries);
+void load_disk(config_t *cfg);
+void load_human(config_t *cfg);
+int parse_human_style(const char *string);
 #if HAVE_MPD
 void load_mpdonair(config_t *cfg);
 int parse_mpd_on_text_fits(const char *string);
 #endif
 
-ArgFunc parse_function(const char *string);
-
 int
 config_lookup_unsigned_int(const config_t *cfg, const char *name, unsigned int *ptr)
 {
@@ -72,6 +96,22 @@ config_setting_get_unsigned_int(const config_setting_t *cfg_item, unsigned int *
 	return 1;
 }
 
+int
+config_setting_lookup_number(const config_setting_t *cfg, const char *name, double *ptr)
+{
+	int integer;
+
+	if (config_setting_lookup_float(cfg, name, ptr))
+		return 1;
+
+	if (config_setting_lookup_int(cfg, name, &integer)) {
+		*ptr = integer;
+		return 1;
+	}
+
+	return 0;
+}
+
 int
 config_lookup_strdup(const config_t *cfg, const char *name, char **strptr)
 {
@@ -115,10 +155,13 @@ set_config_path(const char* filename, char *config_path, char *config_file)
 	snprintf(config_file, PATH_MAX, "%s/%s.cfg", config_path, filename);
 }
 
-void
+/* Returns 0 if the config file exists but could not be parsed */
+int
 load_config(void)
 {
 	config_t cfg;
+	const char *root;
+	int ok = 1;
 	char config_path[PATH_MAX] = {0};
 	char config_file[PATH_MAX] = {0};
 
@@ -127,24 +170,89 @@ load_config(void)
 	config_set_include_dir(&cfg, config_path);
 
 	if (config_read_file(&cfg, config_file)) {
+		reset_options();
 		config_lookup_unsigned_int(&cfg, "interval", &interval);
 		config_lookup_int(&cfg, "maximum_length", &maximum_status_length);
 		config_lookup_strdup(&cfg, "unknown_string", &unknown_string);
+		config_lookup_bool(&cfg, "statistics", &statistics);
+		config_lookup_strdup(&cfg, "statistics_file", &statistics_file);
+		config_lookup_strdup(&cfg, "root", &sysroot);
+		config_lookup_strdup(&cfg, "batch_command", &batch_command);
+		config_lookup_strdup(&cfg, "shm_name", &shm_name);
 		load_modules(&cfg);
+		load_targets(&cfg);
+		load_dusk(&cfg);
+		load_disk(&cfg);
+		load_human(&cfg);
 		#if HAVE_MPD
 		load_mpdonair(&cfg);
 		#endif
 	} else if (strcmp(config_error_text(&cfg), "file I/O error")) {
+		ok = 0;
 		fprintf(stderr, "Error reading config at %s\n", config_file);
 		fprintf(stderr, "%s:%d - %s\n",
 			config_error_file(&cfg),
 			config_error_line(&cfg),
 			config_error_text(&cfg)
 		);
+	} else {
+		reset_options();
+	}
+
+	/* the environment wins so a fixture tree can be used with any config */
+	if ((root = getenv("SLSTATUS_ROOT"))) {
+		free(sysroot);
+		sysroot = strdup(root);
 	}
 
 	load_fallback_config();
 	config_destroy(&cfg);
+
+	return ok;
+}
+
+/*
+ * Sets the options back to their defaults before the config file is read, so
+ * that options removed from it before a reload do not keep their old values.
+ */
+void
+reset_options(void)
+{
+	static unsigned int default_interval;
+	static int saved = 0;
+
+	if (!saved) {
+		default_interval = interval;
+		saved = 1;
+	}
+	interval = default_interval;
+	maximum_status_length = MAXLEN;
+	statistics = 0;
+
+	free(unknown_string);
+	free(statistics_file);
+	free(sysroot);
+	free(batch_command);
+	free(shm_name);
+	free(dusk_events);
+	unknown_string = statistics_file = sysroot = NULL;
+	batch_command = shm_name = dusk_events = NULL;
+
+	free_queries(queries, num_queries);
+	queries = NULL;
+	num_queries = 0;
+
+	disk_timeout = 500;
+	disk_total_on_mount_change = 0;
+	human_precision = 1;
+	human_style = HUMAN_IEC;
+
+	#if HAVE_MPD
+	mpd_title_length = MPD_TITLE_LENGTH;
+	free(mpd_loop_text);
+	mpd_loop_text = NULL;
+	mpd_on_text_fits = MPD_ON_TEXT_FITS;
+	#endif
 }
 
 void
@@ -158,32 +266,91 @@ load_fallback_config(void)
 	}
 	#endif
 
+	/* Scripts have always been able to rely on BAR_HEIGHT */
+	if (!queries) {
+		num_queries = 1;
+		queries = calloc(1, sizeof(struct query));
+		queries[0].name = strdup("BAR_HEIGHT");
+		queries[0].command = strdup("get_bar_height");
+	}
+
+	/* Without targets statuses go to the display slstatus runs on */
+	if (!targets) {
+		num_targets = 1;
+		targets = calloc(1, sizeof(struct target));
+		targets[0].lock_fd = -1;
+	}
+
 	/* Fall back to default configuration if there is no config file */
 	if (!modules) {
 		num_modules = LEN(args);
-		modules = calloc(num_modules, sizeof(arg));
+		modules = calloc(num_modules, sizeof(struct module));
 		for (i = 0; i < num_modules; i++) {
 			modules[i].func = args[i].func;
 			modules[i].fmt = (args[i].fmt ? strdup(args[i].fmt) : NULL);
+			compile_format(&modules[i].format, modules[i].fmt);
 			modules[i].args = (args[i].args ? strdup(args[i].args) : NULL);
 			modules[i].status_no = (args[i].status_no ? strdup(args[i].status_no) : NULL);
 			modules[i].update_interval = args[i].update_interval;
+			modules[i].min_delta = args[i].min_delta;
 		}
 	}
 }
 
 void
-cleanup_config(void)
+free_modules(struct module *modules, int num_modules)
 {
 	int i;
 
-	free(unknown_string);
 	for (i = 0; i < num_modules; i++) {
 		free(modules[i].fmt);
+		free_format(&modules[i].format);
 		free(modules[i].args);
 		free(modules[i].status_no);
+		free(modules[i].last);
 	}
 	free(modules);
+}
+
+void
+free_targets(struct target *targets, int num_targets)
+{
+	int i;
+	size_t j;
+
+	for (i = 0; i < num_targets; i++) {
+		free(targets[i].display);
+		for (j = 0; j < 2 * targets[i].nmap; j++)
+			free(targets[i].map[j]);
+		free(targets[i].map);
+	}
+	free(targets);
+}
+
+void
+free_queries(struct query *queries, int num_queries)
+{
+	int i;
+
+	for (i = 0; i < num_queries; i++) {
+		free(queries[i].name);
+		free(queries[i].command);
+	}
+	free(queries);
+}
+
+void
+cleanup_config(void)
+{
+	free(unknown_string);
+	free(statistics_file);
+	free(sysroot);
+	free(batch_command);
+	free(shm_name);
+	free_modules(modules, num_modules);
+	free_targets(targets, num_targets);
+	free_queries(queries, num_queries);
+	free(dusk_events);
 	#if HAVE_MPD
 	free(mpd_loop_text);
 	#endif
@@ -192,38 +359,207 @@ cleanup_config(void)
 void
 load_modules(config_t *cfg)
 {
-	int i;
+	int i, n;
 	const char *func;
+	const struct function *f;
 	const config_setting_t *modules_t, *module_t;
+	struct module *m;
 
 	modules_t = config_lookup(cfg, "modules");
 	if (!modules_t || !config_setting_is_list(modules_t))
 		return;
 
-	num_modules = config_setting_length(modules_t);
-	if (!num_modules)
+	n = config_setting_length(modules_t);
+	if (!n)
 		return;
 
-	modules = calloc(num_modules, sizeof(arg));
+	modules = calloc(n, sizeof(struct module));
 
 	/* Parse and set the functions and arguments based on config */
-	for (i = 0; i < num_modules; i++) {
+	for (i = 0; i < n; i++) {
 		module_t = config_setting_get_elem(modules_t, i);
 
-		if (config_setting_lookup_string(module_t, "function", &func)) {
-			modules[i].func = parse_function(func);
+		if (!config_setting_lookup_string(module_t, "function", &func)) {
+			fprintf(stderr, "Warning: skipping module %d, no function specified\n", i + 1);
+			continue;
+		}
+		if (!(f = lookup_function(func))) {
+			fprintf(stderr, "Warning: skipping module %d, no function with name %s (see %s -l)\n", i + 1, func, progname);
+			continue;
+		}
+
+		m = &modules[num_modules];
+		m->func = f->func;
+
+		if (!config_setting_lookup_strdup(module_t, "format", &m->fmt))
+			m->fmt = strdup("%s");
+		if (!config_setting_lookup_strdup(module_t, "argument", &m->args))
+			m->args = NULL;
+		if (!m->args && f->arg == ARG_REQUIRED) {
+			fprintf(stderr, "Warning: skipping module %d, function %s requires an argument\n", i + 1, func);
+			free(m->fmt);
+			m->fmt = NULL;
+			continue;
+		}
+		if (compile_format(&m->format, m->fmt) < 0) {
+			free(m->fmt);
+			free(m->args);
+			m->fmt = m->args = NULL;
+			continue;
+		}
+		if (!config_setting_lookup_strdup(module_t, "status_no", &m->status_no)) {
+			fprintf(stderr, "Warning! no status_no specified for function = \"%s\", format = \"%s\", argument = \"%s\"\n", func, m->fmt, m->args);
+			m->status_no = NULL;
+		}
+		if (!config_setting_lookup_unsigned_int(module_t, "update_interval", &m->update_interval) || !m->update_interval)
+			m->update_interval = f->update_interval;
+		if (!config_setting_lookup_number(module_t, "min_delta", &m->min_delta))
+			m->min_delta = 0;
+
+		num_modules++;
+	}
+}
+
+void
+load_targets(config_t *cfg)
+{
+	int i, n;
+	const char *statuses;
+	const config_setting_t *targets_t, *target_t;
+	struct target *t;
+
+	targets_t = config_lookup(cfg, "targets");
+	if (!targets_t || !config_setting_is_list(targets_t))
+		return;
+
+	n = config_setting_length(targets_t);
+	if (!n)
+		return;
+
+	targets = calloc(n, sizeof(struct target));
+
+	for (i = 0; i < n; i++) {
+		target_t = config_setting_get_elem(targets_t, i);
+		t = &targets[num_targets];
+		t->lock_fd = -1;
+
+		if (!config_setting_lookup_strdup(target_t, "display", &t->display)) {
+			fprintf(stderr, "Warning: skipping target %d, no display specified\n", i + 1);
+			continue;
+		}
+		if (config_setting_lookup_string(target_t, "statuses", &statuses) &&
+		    !parse_statuses(t, statuses)) {
+			fprintf(stderr, "Warning: skipping target %d, statuses must be a list of status_no[:status_no]\n", i + 1);
+			free(t->display);
+			t->display = NULL;
+			continue;
+		}
+
+		num_targets++;
+	}
+
+	if (!num_targets) {
+		free(targets);
+		targets = NULL;
+	}
+}
+
+/* Parses "1 2:5 3" into source and destination status_no pairs */
+int
+parse_statuses(struct target *t, const char *string)
+{
+	const char *p, *q, *colon;
+	size_t len, n = 0;
+	char **map;
+
+	for (p = string; *p; p++)
+		n += !strchr(" ,", *p) && (p == string || strchr(" ,", p[-1]));
+	if (!n || !(map = calloc(2 * n, sizeof(char *))))
+		return 0;
+
+	for (p = string, n = 0; *p; p = q) {
+		for (; *p && strchr(" ,", *p); p++)
+			;
+		for (q = p; *q && !strchr(" ,", *q); q++)
+			;
+		if (q == p)
+			break;
+
+		colon = memchr(p, ':', q - p);
+		len = colon ? (size_t)(colon - p) : (size_t)(q - p);
+		map[2 * n] = strndup(p, len);
+		map[2 * n + 1] = colon ? strndup(colon + 1, q - colon - 1) : strdup(map[2 * n]);
+		if (!len || !map[2 * n + 1][0]) {
+			for (n = 2 * n + 2; n > 0; n--)
+				free(map[n - 1]);
+			free(map);
+			return 0;
 		}
+		n++;
+	}
 
-		if (!config_setting_lookup_strdup(module_t, "format", &modules[i].fmt))
-			modules[i].fmt = strdup("%s");
-		if (!config_setting_lookup_strdup(module_t, "argument", &modules[i].args))
-			modules[i].args = NULL;
-		if (!config_setting_lookup_strdup(module_t, "status_no", &modules[i].status_no)) {
-			fprintf(stderr, "Warning! no status_no specified for function = \"%s\", format = \"%s\", argument = \"%s\"\n", func, modules[i].fmt, modules[i].args);
-			modules[i].status_no = NULL;
+	t->map = map;
+	t->nmap = n;
+	return 1;
+}
+
+void
+load_dusk(config_t *cfg)
+{
+	int i, n;
+	const config_setting_t *queries_t, *query_t;
+	struct query *q;
+
+	config_lookup_strdup(cfg, "dusk.events", &dusk_events);
+
+	queries_t = config_lookup(cfg, "dusk.queries");
+	if (!queries_t || !config_setting_is_list(queries_t))
+		return;
+
+	free_queries(queries, num_queries);
+	queries = NULL;
+	num_queries = 0;
+
+	/* an empty list turns off the default query as well */
+	n = config_setting_length(queries_t);
+	queries = calloc(n ? n : 1, sizeof(struct query));
+
+	for (i = 0; i < n; i++) {
+		query_t = config_setting_get_elem(queries_t, i);
+		q = &queries[num_queries];
+
+		if (!config_setting_lookup_strdup(query_t, "name", &q->name) ||
+		    !config_setting_lookup_strdup(query_t, "command", &q->command)) {
+			fprintf(stderr, "Warning: skipping dusk query %d, it needs a name and a command\n", i + 1);
+			free(q->name);
+			free(q->command);
+			q->name = q->command = NULL;
+			continue;
 		}
-		if (!config_setting_lookup_unsigned_int(module_t, "update_interval", &modules[i].update_interval))
-			modules[i].update_interval = 1;
+
+		num_queries++;
+	}
+}
+
+void
+load_disk(config_t *cfg)
+{
+	config_lookup_unsigned_int(cfg, "disk.timeout", &disk_timeout);
+	config_lookup_bool(cfg, "disk.total_on_mount_change", &disk_total_on_mount_change);
+}
+
+void
+load_human(config_t *cfg)
+{
+	const char *string;
+
+	if (config_lookup_int(cfg, "human.precision", &human_precision) &&
+	    (human_precision < 0 || human_precision > 3)) {
+		fprintf(stderr, "Warning: human.precision must be between 0 and 3\n");
+		human_precision = human_precision < 0 ? 0 : 3;
+	}
+	if (config_lookup_string(cfg, "human.style", &string)) {
+		human_style = parse_human_style(string);
 	}
 }
 
@@ -243,60 +579,15 @@ load_mpdonair(config_t *cfg)
 
 #define map(S, I) if (!strcasecmp(string, S)) return I;
 
-ArgFunc
-parse_function(const char *string)
+int
+parse_human_style(const char *string)
 {
-	map("backlight_perc", backlight_perc);
-	map("battery_perc", battery_perc);
-	map("battery_remaining", battery_remaining);
-	map("battery_state", battery_state);
-	map("cat", cat);
-	map("cpu_freq", cpu_freq);
-	map("cpu_perc", cpu_perc);
-	map("datetime", datetime);
-	map("disk_free", disk_free);
-	map("disk_perc", disk_perc);
-	map("disk_total", disk_total);
-	map("disk_used", disk_used);
-	map("entropy", entropy);
-	map("gid", gid);
-	map("hostname", hostname);
-	map("io_in", io_in);
-	map("io_out", io_out);
-	map("io_perc", io_perc);
-	map("ipv4", ipv4);
-	map("ipv6", ipv6);
-	map("kernel_release", kernel_release);
-	map("keyboard_indicators", keyboard_indicators);
-	map("keymap", keymap);
-	map("load_avg", load_avg);
-	#if HAVE_MPD
-	map("mpdonair", mpdonair);
-	#endif
-	map("netspeed_rx", netspeed_rx);
-	map("netspeed_tx", netspeed_tx);
-	map("num_files", num_files);
-	map("ram_free", ram_free);
-	map("ram_perc", ram_perc);
-	map("ram_total", ram_total);
-	map("ram_used", ram_used);
-	map("run_command", run_command);
-	map("run_exec", run_exec);
-	map("run_exec", run_exec);
-	map("swap_free", swap_free);
-	map("swap_perc", swap_perc);
-	map("swap_total", swap_total);
-	map("swap_used", swap_used);
-	map("temp", temp);
-	map("uid", uid);
-	map("uptime", uptime);
-	map("username", username);
-	map("vol_perc", vol_perc);
-	map("wifi_essid", wifi_essid);
-	map("wifi_perc", wifi_perc);
-
-	fprintf(stderr, "Warning: config could not find function with name %s\n", string);
-	return datetime;
+	map("IEC", HUMAN_IEC);
+	map("COMPACT", HUMAN_COMPACT);
+	map("SHORT", HUMAN_SHORT);
+
+	fprintf(stderr, "Warning: config could not find human style with name %s\n", string);
+	return HUMAN_IEC;
 }
 
 #if HAVE_MPD
@@ -22,9 +22,25 @@ static const char unknown_str[] = "n/a";
  * battery_state       battery charging state          battery name (BAT0)
  *                                                     NULL on OpenBSD/FreeBSD
  * cat                 read arbitrary file             path
- * cpu_freq            cpu frequency in MHz            NULL
+ * cg_cpu_perc         cpu usage in percent of the     cgroup v2 path below
+ *                     cgroup's cpu.max (Linux)        the mount point
+ *                                                     (user.slice), NULL
+ *                                                     for our own
+ * cg_mem_free         cgroup memory left before its   as cg_cpu_perc
+ *                     memory.max or the machine's
+ * cg_mem_max          cgroup memory limit             as cg_cpu_perc
+ * cg_mem_perc         cgroup memory usage in percent  as cg_cpu_perc
+ *                     of its limit
+ * cg_mem_used         cgroup memory usage, without    as cg_cpu_perc
+ *                     inactive file pages
+ * cpu_freq            cpu frequency in MHz            cpu number, avg, max
+ *                                                     or min of all cpus
+ *                                                     (avg), cpu 0 if NULL
+ *                                                     NULL on OpenBSD/FreeBSD
  * cpu_perc            cpu usage in percent            NULL
  * datetime            date and time                   format string (%F %T)
+ * datetime_tz         date and time in another zone   zone and format string
+ *                                                     (Asia/Tokyo %R)
  * disk_free           free disk space in GB           mountpoint path (/)
  * disk_perc           disk usage in percent           mountpoint path (/)
  * disk_total          total disk space in GB          mountpoint path (/)
@@ -32,9 +48,12 @@ static const char unknown_str[] = "n/a";
  * entropy             available entropy               NULL
  * gid                 GID of current user             NULL
  * hostname            hostname                        NULL
- * io_in               disk IO (read)                  NULL
- * io_out              disk IO (write)                 NULL
- * io_perc             disk IO (percentage)            NULL
+ * io_in               disk IO (read) per second       block device (nvme0n1),
+ *                                                     NULL for all disks
+ * io_out              disk IO (write) per second      block device (nvme0n1),
+ *                                                     NULL for all disks
+ * io_perc             disk IO utilisation in percent  block device (nvme0n1),
+ *                                                     NULL for all disks
  * ipv4                IPv4 address                    interface name (eth0)
  * ipv6                IPv6 address                    interface name (eth0)
  * kernel_release      `uname -r`                      NULL
@@ -53,6 +72,16 @@ static const char unknown_str[] = "n/a";
  * netspeed_tx         transfer network speed          interface name (wlan0)
  * num_files           number of files in a directory  path
  *                                                     (/home/foo/Inbox/cur)
+ * procs               number of processes (Linux)     NULL
+ * psi_cpu             cpu pressure stall avg10 and    some or full (some),
+ *                     avg60 in percent (Linux)        optionally followed
+ *                                                     by a trigger stall
+ *                                                     and window in us
+ *                                                     (some 150000 1000000)
+ *                                                     to update when the
+ *                                                     kernel reports it
+ * psi_io              io pressure, as psi_cpu         as psi_cpu
+ * psi_mem             memory pressure, as psi_cpu     as psi_cpu
  * ram_free            free memory in GB               NULL
  * ram_perc            memory usage in percent         NULL
  * ram_total           total memory size in GB         NULL
@@ -62,6 +91,19 @@ static const char unknown_str[] = "n/a";
  *                                                     runs command through posix_spawnp instead of
  *                                                     popen which starts a shell
  * run_exec            custom exec command             exec
+ * si_ram_free         free memory from sysinfo(2)     NULL
+ * si_ram_perc         memory usage in percent from    NULL
+ *                     sysinfo(2), counting the cache
+ *                     as used
+ * si_ram_total        total memory from sysinfo(2)    NULL
+ * si_ram_used         used memory from sysinfo(2)     NULL
+ * si_swap_free        free swap from sysinfo(2)       NULL
+ * si_swap_perc        swap usage in percent from      NULL
+ *                     sysinfo(2)
+ * si_swap_total       total swap from sysinfo(2)      NULL
+ * si_swap_used        used swap from sysinfo(2)       NULL
+ *                     off Linux the si_ modules are
+ *                     the same as ram_ and swap_
  * swap_free           free swap in GB                 NULL
  * swap_perc           swap usage in percent           NULL
  * swap_total          total swap size in GB           NULL
@@ -71,6 +113,10 @@ static const char unknown_str[] = "n/a";
  *                                                     NULL on OpenBSD
  *                                                     thermal zone on FreeBSD
  *                                                     (tz0, tz1, etc.)
+ * top_proc            processes using the most cpu    cpu or mem and how
+ *                     (in percent of one cpu) or      many to list (cpu 3),
+ *                     memory, Linux only              the top one by cpu
+ *                                                     if NULL
  * uid                 UID of current user             NULL
  * uptime              system uptime                   NULL
  * username            username of current user        NULL
@@ -78,8 +124,14 @@ static const char unknown_str[] = "n/a";
  *                                                     NULL on OpenBSD/FreeBSD
  * wifi_essid          WiFi ESSID                      interface name (wlan0)
  * wifi_perc           WiFi signal in percent          interface name (wlan0)
+ * wifi_rx_bitrate     WiFi receive bitrate (bit/s)    interface name (wlan0)
+ * wifi_signal         WiFi signal in dBm              interface name (wlan0)
+ * wifi_tx_bitrate     WiFi transmit bitrate (bit/s)   interface name (wlan0)
+ *
+ * An update_interval of ONCE evaluates the module on start and on SIGHUP only,
+ * for values that do not change on their own (uid, username, ...).
  */
 static const struct arg args[] = {
-	/* function format          argument      status_no     update_interval */
-	{ datetime, "%s",           "%F %T",      "1",          1 },
+	/* function format          argument      status_no     update_interval  min_delta */
+	{ datetime, "%s",           "%F %T",      "1",          1,               0 },
 };
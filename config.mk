@@ -35,7 +35,8 @@ CFLAGS   = -std=c99 -pedantic -Wall -Wextra -Wno-unused-parameter -Os
 LDFLAGS  = -s
 # OpenBSD: add -lsndio
 # FreeBSD: add -lkvm -lsndio
-LDLIBS   = `$(PKG_CONFIG) --libs x11` $(MPDLIBS) $(CONFIG)
+# glibc before 2.34: add -lrt
+LDLIBS   = `$(PKG_CONFIG) --libs x11` $(MPDLIBS) $(CONFIG) -lpthread
 LDINCS   = $(MPDINCS)
 
 # compiler and linker
@@ -0,0 +1,241 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "dusk.h"
+#include "util.h"
+
+#define MAX_ARGS 10
+#define RESUBSCRIBE_SECS 60 /* how long to wait before retrying duskc subscribe */
+#define QUERY_TIMEOUT_MS 500 /* how long a query may take before duskc is killed */
+
+extern char **environ;
+
+static pid_t subpid = -1;
+static int subfd = -1;
+static char *subevents;
+static time_t subtime;
+
+/*
+ * Runs duskc with the space separated args, its stdout connected to the
+ * returned pipe. The shell is left out, this runs on every event.
+ */
+static int
+duskc(const char *args, pid_t *pid)
+{
+	char *argv[MAX_ARGS + 2], *copy, *token;
+	int argc = 0, pipefd[2], err;
+	posix_spawn_file_actions_t actions;
+
+	if (!(copy = strdup(args))) {
+		warn("strdup:");
+		return -1;
+	}
+	argv[argc++] = "duskc";
+	for (token = strtok(copy, " "); token && argc < MAX_ARGS + 1;
+	     token = strtok(NULL, " "))
+		argv[argc++] = token;
+	argv[argc] = NULL;
+
+	if (pipe(pipefd) < 0) {
+		warn("pipe:");
+		free(copy);
+		return -1;
+	}
+	fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addclose(&actions, pipefd[0]);
+	posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&actions, pipefd[1]);
+	err = posix_spawnp(pid, argv[0], &actions, NULL, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(pipefd[1]);
+	free(copy);
+
+	if (err) {
+		errno = err;
+		warn("posix_spawnp 'duskc %s':", args);
+		close(pipefd[0]);
+		return -1;
+	}
+
+	return pipefd[0];
+}
+
+static long
+msleft(const struct timespec *start)
+{
+	struct timespec now;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+		return 0;
+
+	return QUERY_TIMEOUT_MS - (now.tv_sec - start->tv_sec) * 1000 -
+	       (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/*
+ * Sets every query's variable to the first line duskc prints for it, for
+ * run_command and run_exec scripts to use. Failed queries unset it, as do
+ * queries that take longer than QUERY_TIMEOUT_MS, so that a dusk that
+ * hangs does not hold up the main loop.
+ */
+void
+refresh_queries(const struct query *queries, int num_queries)
+{
+	struct pollfd pfd;
+	struct timespec start;
+	char out[256], *nl;
+	size_t len;
+	ssize_t n;
+	pid_t pid;
+	long left;
+	int i, fd, status;
+
+	for (i = 0; i < num_queries; i++) {
+		if (clock_gettime(CLOCK_MONOTONIC, &start) < 0 ||
+		    (fd = duskc(queries[i].command, &pid)) < 0)
+			continue;
+
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		for (len = 0; len < sizeof(out) - 1; ) {
+			if ((left = msleft(&start)) <= 0 ||
+			    (n = poll(&pfd, 1, left)) == 0) {
+				warn("duskc %s: No reply within %d ms",
+				     queries[i].command, QUERY_TIMEOUT_MS);
+				kill(pid, SIGKILL);
+				len = 0;
+				break;
+			} else if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				warn("poll:");
+				kill(pid, SIGKILL);
+				len = 0;
+				break;
+			}
+			if ((n = read(fd, out + len, sizeof(out) - 1 - len)) > 0)
+				len += n;
+			else if (n == 0 || errno != EINTR)
+				break;
+		}
+		out[len] = '\0';
+		close(fd);
+		while (waitpid(pid, &status, 0) < 0)
+			if (errno != EINTR) {
+				status = -1;
+				break;
+			}
+
+		if ((nl = strchr(out, '\n')))
+			*nl = '\0';
+		if (out[0] && WIFEXITED(status) && !WEXITSTATUS(status))
+			setenv(queries[i].name, out, 1);
+		else
+			unsetenv(queries[i].name);
+	}
+}
+
+static void
+unsubscribe(void)
+{
+	if (subfd >= 0) {
+		unwatchfd(subfd);
+		close(subfd);
+	}
+	if (subpid > 0) {
+		kill(subpid, SIGTERM);
+		while (waitpid(subpid, NULL, 0) < 0 && errno == EINTR)
+			;
+	}
+	subfd = -1;
+	subpid = -1;
+}
+
+static int
+subscribe(void)
+{
+	char *args;
+
+	subtime = time(NULL);
+	if (!(args = malloc(strlen(subevents) + sizeof("subscribe ")))) {
+		warn("malloc:");
+		return -1;
+	}
+	sprintf(args, "subscribe %s", subevents);
+	if ((subfd = duskc(args, &subpid)) >= 0) {
+		fcntl(subfd, F_SETFL, O_NONBLOCK);
+		/* wakes up the main loop, pending_events does the rest */
+		watchfd(subfd, POLLIN);
+	}
+	free(args);
+
+	return subfd < 0 ? -1 : 0;
+}
+
+/*
+ * Keeps a duskc subscribed to the space separated events, replacing the
+ * subscription if they differ. NULL or "" stops listening.
+ */
+int
+subscribe_events(const char *events)
+{
+	if (events && subevents && !strcmp(events, subevents))
+		return 0;
+	unsubscribe();
+	free(subevents);
+	subevents = NULL;
+	if (!events || !events[0])
+		return 0;
+
+	if (!(subevents = strdup(events))) {
+		warn("strdup:");
+		return -1;
+	}
+
+	return subscribe();
+}
+
+/*
+ * Returns 1 if dusk reported any of the subscribed events since the last
+ * call, without blocking. If dusk went away, subscribing is retried every
+ * minute and 1 is returned once it worked again, as anything may have changed.
+ */
+int
+pending_events(void)
+{
+	char drain[4096];
+	ssize_t n;
+	int got = 0;
+
+	if (!subevents)
+		return 0;
+
+	if (subfd < 0) {
+		if (time(NULL) - subtime < RESUBSCRIBE_SECS)
+			return 0;
+		return subscribe() == 0;
+	}
+
+	while ((n = read(subfd, drain, sizeof(drain))) > 0)
+		got = 1;
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+		/* duskc exited, keep the events to subscribe again later */
+		unsubscribe();
+		subtime = time(NULL);
+	}
+
+	return got;
+}
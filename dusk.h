@@ -0,0 +1,11 @@
+/* See LICENSE file for copyright and license details. */
+
+/* An environment variable set from the output of a duskc command */
+struct query {
+	char *name;
+	char *command; /* arguments to duskc, split on spaces */
+};
+
+void refresh_queries(const struct query *queries, int num_queries);
+int subscribe_events(const char *events);
+int pending_events(void);
@@ -0,0 +1,93 @@
+#!/bin/sh
+# See LICENSE file for copyright and license details.
+#
+# Records the /proc and /sys files read by the status functions into a
+# directory tree that slstatus and slstatus-bench can be pointed at with
+# SLSTATUS_ROOT (or -r for slstatus-bench), so the parsing paths can be run
+# and measured on a machine without the hardware.
+#
+# usage: mkfixture.sh directory
+
+if [ $# -ne 1 ]; then
+	echo "usage: $0 directory" >&2
+	exit 1
+fi
+dest=$1
+
+# copy a file to the same path below $dest, following symlinks on the way
+copy() {
+	for f; do
+		[ -r "$f" ] || continue
+		mkdir -p "$dest${f%/*}" && cat "$f" > "$dest$f" 2>/dev/null ||
+			rm -f "$dest$f"
+	done
+}
+
+# record that a directory exists, its contents are not read
+mark() {
+	for d; do
+		[ -d "$d" ] && mkdir -p "$dest$d"
+	done
+}
+
+copy /proc/stat /proc/meminfo /proc/diskstats /proc/net/wireless \
+     /proc/self/mountinfo /proc/sys/kernel/random/entropy_avail \
+     /proc/pressure/cpu /proc/pressure/memory /proc/pressure/io
+
+# cpuN/cpufreq links to the policy of the cpus sharing a clock, keep the links
+for d in /sys/devices/system/cpu/cpu[0-9]*; do
+	mark "$d"
+	if [ -L "$d/cpufreq" ]; then
+		ln -s "$(readlink "$d/cpufreq")" "$dest$d/cpufreq"
+	else
+		copy "$d/cpufreq/scaling_cur_freq"
+	fi
+done
+for f in /sys/devices/system/cpu/cpufreq/policy*/scaling_cur_freq; do
+	copy "$f"
+done
+
+# our own cgroup v2 and its ancestors, on which limits may be set
+mnt=$(awk '/ - cgroup2 / { print $5; exit }' /proc/self/mountinfo)
+if [ -n "$mnt" ]; then
+	copy /proc/self/cgroup
+	d=$mnt$(sed -n 's/^0::\/*/\//p' /proc/self/cgroup)
+	d=${d%/}
+	while :; do
+		copy "$d/memory.current" "$d/memory.stat" "$d/memory.max" \
+		     "$d/cpu.stat" "$d/cpu.max"
+		[ "${#d}" -le "${#mnt}" ] && break
+		d=${d%/*}
+	done
+fi
+
+for f in /proc/[0-9]*/stat; do
+	copy "$f"
+done
+
+for d in /sys/block/*; do
+	mark "$d"
+done
+for d in /sys/devices/virtual/block/*; do
+	mark "$d"
+done
+
+for d in /sys/class/net/*; do
+	copy "$d/operstate" "$d/statistics/rx_bytes" "$d/statistics/tx_bytes"
+done
+
+for d in /sys/class/power_supply/*; do
+	copy "$d/capacity" "$d/status" "$d/charge_now" "$d/energy_now" \
+	     "$d/current_now" "$d/power_now"
+done
+
+for d in /sys/class/backlight/*; do
+	copy "$d/brightness" "$d/max_brightness"
+done
+
+for f in /sys/class/thermal/thermal_zone*/temp \
+         /sys/class/hwmon/hwmon*/temp*_input; do
+	copy "$f"
+done
+
+exit 0
@@ -0,0 +1,164 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "registry.h"
+#include "slstatus.h"
+#include "util.h"
+
+/* these take a device or file on Linux, but not on all BSDs */
+#if defined(__linux__)
+	#define ARG_LINUX ARG_REQUIRED
+#else
+	#define ARG_LINUX ARG_OPTIONAL
+#endif
+
+/*
+ * Every status module that can be referred to by name in the config.
+ *
+ * Adding a component only requires a line here, the table is sorted on
+ * first use so the order does not matter.
+ */
+static struct function functions[] = {
+	/* name                  function             argument      interval  description */
+	{ "backlight_perc",      backlight_perc,      ARG_LINUX,    1,    "backlight percentage" },
+	{ "battery_perc",        battery_perc,        ARG_LINUX,    1,    "battery percentage" },
+	{ "battery_remaining",   battery_remaining,   ARG_LINUX,    1,    "battery remaining HH:MM" },
+	{ "battery_state",       battery_state,       ARG_LINUX,    1,    "battery charging state" },
+	{ "cat",                 cat,                 ARG_REQUIRED, 1,    "read arbitrary file" },
+	{ "cg_cpu_perc",         cg_cpu_perc,         ARG_OPTIONAL, 1,    "cgroup cpu usage in percent of cpu.max" },
+	{ "cg_mem_free",         cg_mem_free,         ARG_OPTIONAL, 1,    "cgroup memory left before memory.max" },
+	{ "cg_mem_max",          cg_mem_max,          ARG_OPTIONAL, 60,   "cgroup memory limit" },
+	{ "cg_mem_perc",         cg_mem_perc,         ARG_OPTIONAL, 1,    "cgroup memory usage in percent of memory.max" },
+	{ "cg_mem_used",         cg_mem_used,         ARG_OPTIONAL, 1,    "cgroup memory usage" },
+	{ "cpu_freq",            cpu_freq,            ARG_OPTIONAL, 1,    "cpu frequency in MHz" },
+	{ "cpu_perc",            cpu_perc,            ARG_NONE,     1,    "cpu usage in percent" },
+	{ "datetime",            datetime,            ARG_REQUIRED, 1,    "date and time" },
+	{ "datetime_tz",         datetime_tz,         ARG_REQUIRED, 1,    "date and time in another time zone" },
+	{ "disk_free",           disk_free,           ARG_REQUIRED, 1,    "free disk space" },
+	{ "disk_perc",           disk_perc,           ARG_REQUIRED, 1,    "disk usage in percent" },
+	{ "disk_total",          disk_total,          ARG_REQUIRED, 60,   "total disk space" },
+	{ "disk_used",           disk_used,           ARG_REQUIRED, 1,    "used disk space" },
+	{ "entropy",             entropy,             ARG_NONE,     1,    "available entropy" },
+	{ "gid",                 gid,                 ARG_NONE,     ONCE, "GID of current user" },
+	{ "hostname",            hostname,            ARG_NONE,     ONCE, "hostname" },
+	{ "io_in",               io_in,               ARG_OPTIONAL, 1,    "disk IO (read) per second" },
+	{ "io_out",              io_out,              ARG_OPTIONAL, 1,    "disk IO (write) per second" },
+	{ "io_perc",             io_perc,             ARG_OPTIONAL, 1,    "disk IO utilisation in percent" },
+	{ "ipv4",                ipv4,                ARG_REQUIRED, 1,    "IPv4 address" },
+	{ "ipv6",                ipv6,                ARG_REQUIRED, 1,    "IPv6 address" },
+	{ "kernel_release",      kernel_release,      ARG_NONE,     ONCE, "`uname -r`" },
+	{ "keyboard_indicators", keyboard_indicators, ARG_REQUIRED, 1,    "caps/num lock indicators" },
+	{ "keymap",              keymap,              ARG_NONE,     1,    "layout (variant) of current keymap" },
+	{ "load_avg",            load_avg,            ARG_NONE,     1,    "load average" },
+	#if HAVE_MPD
+	{ "mpdonair",            mpdonair,            ARG_REQUIRED, 1,    "mpd status" },
+	#endif
+	{ "netspeed_rx",         netspeed_rx,         ARG_REQUIRED, 1,    "receive network speed" },
+	{ "netspeed_tx",         netspeed_tx,         ARG_REQUIRED, 1,    "transfer network speed" },
+	{ "num_files",           num_files,           ARG_REQUIRED, 1,    "number of files in a directory" },
+	{ "procs",               procs,               ARG_NONE,     1,    "number of processes" },
+	{ "psi_cpu",             psi_cpu,             ARG_OPTIONAL, 1,    "cpu pressure avg10 avg60" },
+	{ "psi_io",              psi_io,              ARG_OPTIONAL, 1,    "io pressure avg10 avg60" },
+	{ "psi_mem",             psi_mem,             ARG_OPTIONAL, 1,    "memory pressure avg10 avg60" },
+	{ "ram_free",            ram_free,            ARG_NONE,     1,    "free memory" },
+	{ "ram_perc",            ram_perc,            ARG_NONE,     1,    "memory usage in percent" },
+	{ "ram_total",           ram_total,           ARG_NONE,     60,   "total memory size" },
+	{ "ram_used",            ram_used,            ARG_NONE,     1,    "used memory" },
+	{ "run_command",         run_command,         ARG_REQUIRED, 1,    "custom shell command" },
+	{ "run_exec",            run_exec,            ARG_REQUIRED, 1,    "custom exec command" },
+	{ "si_ram_free",         si_ram_free,         ARG_NONE,     1,    "free memory (sysinfo)" },
+	{ "si_ram_perc",         si_ram_perc,         ARG_NONE,     1,    "memory usage in percent (sysinfo)" },
+	{ "si_ram_total",        si_ram_total,        ARG_NONE,     60,   "total memory size (sysinfo)" },
+	{ "si_ram_used",         si_ram_used,         ARG_NONE,     1,    "used memory (sysinfo)" },
+	{ "si_swap_free",        si_swap_free,        ARG_NONE,     1,    "free swap (sysinfo)" },
+	{ "si_swap_perc",        si_swap_perc,        ARG_NONE,     1,    "swap usage in percent (sysinfo)" },
+	{ "si_swap_total",       si_swap_total,       ARG_NONE,     60,   "total swap size (sysinfo)" },
+	{ "si_swap_used",        si_swap_used,        ARG_NONE,     1,    "used swap (sysinfo)" },
+	{ "swap_free",           swap_free,           ARG_NONE,     1,    "free swap" },
+	{ "swap_perc",           swap_perc,           ARG_NONE,     1,    "swap usage in percent" },
+	{ "swap_total",          swap_total,          ARG_NONE,     60,   "total swap size" },
+	{ "swap_used",           swap_used,           ARG_NONE,     1,    "used swap" },
+	{ "temp",                temp,                ARG_LINUX,    1,    "temperature in degree celsius" },
+	{ "top_proc",            top_proc,            ARG_OPTIONAL, 1,    "processes using the most cpu or memory" },
+	{ "uid",                 uid,                 ARG_NONE,     ONCE, "UID of current user" },
+	{ "uptime",              uptime,              ARG_NONE,     1,    "system uptime" },
+	{ "username",            username,            ARG_NONE,     ONCE, "username of current user" },
+	{ "vol_perc",            vol_perc,            ARG_LINUX,    1,    "OSS/ALSA volume in percent" },
+	{ "wifi_essid",          wifi_essid,          ARG_REQUIRED, 1,    "WiFi ESSID" },
+	{ "wifi_perc",           wifi_perc,           ARG_REQUIRED, 1,    "WiFi signal in percent" },
+	{ "wifi_rx_bitrate",     wifi_rx_bitrate,     ARG_REQUIRED, 1,    "WiFi receive bitrate" },
+	{ "wifi_signal",         wifi_signal,         ARG_REQUIRED, 1,    "WiFi signal in dBm" },
+	{ "wifi_tx_bitrate",     wifi_tx_bitrate,     ARG_REQUIRED, 1,    "WiFi transmit bitrate" },
+};
+
+static int
+cmpfunction(const void *a, const void *b)
+{
+	return strcasecmp(((const struct function *)a)->name,
+	                  ((const struct function *)b)->name);
+}
+
+static void
+sortfunctions(void)
+{
+	static int sorted;
+
+	if (sorted)
+		return;
+
+	qsort(functions, LEN(functions), sizeof(*functions), cmpfunction);
+	sorted = 1;
+}
+
+/* Iterates over the functions in name order, NULL past the end */
+const struct function *
+function_at(size_t i)
+{
+	sortfunctions();
+	return i < LEN(functions) ? &functions[i] : NULL;
+}
+
+const struct function *
+lookup_function(const char *name)
+{
+	struct function key = { .name = name };
+
+	sortfunctions();
+	return bsearch(&key, functions, LEN(functions), sizeof(*functions),
+	               cmpfunction);
+}
+
+const char *
+function_name(const char *(*func)(const char *))
+{
+	size_t i;
+
+	for (i = 0; i < LEN(functions); i++)
+		if (functions[i].func == func)
+			return functions[i].name;
+
+	return NULL;
+}
+
+void
+list_functions(void)
+{
+	static const char *argnames[] = {
+		[ARG_NONE]     = "none",
+		[ARG_OPTIONAL] = "optional",
+		[ARG_REQUIRED] = "required",
+	};
+	size_t i;
+
+	sortfunctions();
+	for (i = 0; i < LEN(functions); i++) {
+		printf("%-20s %-9s ", functions[i].name, argnames[functions[i].arg]);
+		if (functions[i].update_interval == ONCE)
+			printf("%-4s ", "once");
+		else
+			printf("%-4u ", functions[i].update_interval);
+		printf("%s\n", functions[i].description);
+	}
+}
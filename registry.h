@@ -0,0 +1,25 @@
+/* See LICENSE file for copyright and license details. */
+#include <stddef.h>
+
+enum {
+	ARG_NONE,     /* the argument is ignored */
+	ARG_OPTIONAL, /* the module has a sensible default without one */
+	ARG_REQUIRED,
+};
+
+/* update_interval of values that do not change on their own */
+#define ONCE 0
+
+struct function {
+	const char *name;
+	const char *(*func)(const char *);
+	int arg;
+	unsigned int update_interval; /* used if the config does not say,
+	                               * ONCE to evaluate on start and SIGHUP */
+	const char *description;
+};
+
+const struct function *function_at(size_t i);
+const struct function *lookup_function(const char *name);
+const char *function_name(const char *(*func)(const char *));
+void list_functions(void);
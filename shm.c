@@ -0,0 +1,193 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm.h"
+#include "util.h"
+
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+
+	static void
+	wake(uint32_t *addr)
+	{
+		/* not FUTEX_PRIVATE_FLAG, the waiters are other processes */
+		syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+#else
+	static void
+	wake(uint32_t *addr)
+	{
+		/* readers have to poll generation */
+	}
+#endif
+
+static struct shm_header *hdr;
+static size_t maplen;
+static char *shmname;
+
+static void
+detach(void)
+{
+	if (!hdr)
+		return;
+
+	__atomic_store_n(&hdr->pid, 0, __ATOMIC_RELAXED);
+	commit_shm();
+	munmap(hdr, maplen);
+	shm_unlink(shmname);
+	free(shmname);
+	hdr = NULL;
+	shmname = NULL;
+}
+
+/*
+ * Whether the object name was left behind by an slstatus of ours that is
+ * gone, e.g. one that was killed, and may be replaced. One that is still
+ * published or was not created by slstatus is left alone.
+ */
+static int
+stale(const char *name)
+{
+	struct shm_header *h;
+	struct stat st;
+	int fd, ret = 0;
+
+	if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+		return errno == ENOENT;
+	if (fstat(fd, &st) < 0 || st.st_uid != getuid() ||
+	    (size_t)st.st_size < sizeof(*h) ||
+	    (h = mmap(NULL, sizeof(*h), PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return 0;
+	}
+	close(fd);
+
+	if (h->magic == SHM_MAGIC &&
+	    (h->pid == 0 || (kill(h->pid, 0) < 0 && errno == ESRCH)))
+		ret = 1;
+	munmap(h, sizeof(*h));
+
+	return ret;
+}
+
+/*
+ * Publishes the statuses in the POSIX shared memory object name, replacing
+ * the one published before if the name or text length differ. A NULL name
+ * stops publishing.
+ */
+int
+attach_shm(const char *name, size_t textlen)
+{
+	size_t slotsize;
+	int fd;
+
+	slotsize = (sizeof(struct shm_slot) + textlen + 63) & ~(size_t)63;
+	if (hdr && name && !strcmp(name, shmname) && hdr->slotsize == slotsize)
+		return 0;
+	detach();
+	if (!name)
+		return 0;
+
+	/* start afresh, readers of a previous instance keep their mapping */
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0 &&
+	    errno == EEXIST) {
+		if (!stale(name)) {
+			warn("shm: '%s' is in use by another slstatus or program, "
+			     "not publishing", name);
+			return -1;
+		}
+		shm_unlink(name);
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	}
+	if (fd < 0) {
+		warn("shm_open '%s':", name);
+		return -1;
+	}
+	maplen = sizeof(struct shm_header) + SHM_SLOTS * slotsize;
+	if (ftruncate(fd, maplen) < 0) {
+		warn("ftruncate '%s':", name);
+		goto err;
+	}
+	if ((hdr = mmap(NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+	                0)) == MAP_FAILED) {
+		hdr = NULL;
+		warn("mmap '%s':", name);
+		goto err;
+	}
+	close(fd);
+
+	if (!(shmname = strdup(name))) {
+		warn("strdup:");
+		munmap(hdr, maplen);
+		shm_unlink(name);
+		hdr = NULL;
+		return -1;
+	}
+
+	/* ftruncate zeroed the segment: every slot is empty */
+	hdr->version = SHM_VERSION;
+	hdr->nslots = SHM_SLOTS;
+	hdr->slotsize = slotsize;
+	hdr->pid = getpid();
+	__atomic_store_n(&hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return 0;
+
+err:
+	close(fd);
+	shm_unlink(name);
+	return -1;
+}
+
+void
+set_shm_status(const char *status_no, const char *status)
+{
+	static int warned;
+	struct shm_slot *s;
+	size_t len;
+	char *end;
+	long n;
+
+	if (!hdr)
+		return;
+
+	n = strtol(status_no, &end, 10);
+	if (*end || n < 0 || n >= SHM_SLOTS) {
+		if (!warned++)
+			warn("shm: status_no '%s' has no slot, only 0 to %d are "
+			     "published", status_no, SHM_SLOTS - 1);
+		return;
+	}
+
+	s = SHM_SLOT(hdr, n);
+	len = strlen(status);
+	if (len > hdr->slotsize - sizeof(*s) - 1)
+		len = hdr->slotsize - sizeof(*s) - 1;
+
+	__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&s->len, len, __ATOMIC_RELAXED);
+	memcpy(s->text, status, len);
+	s->text[len] = '\0';
+	__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Tells readers that a batch of updates is complete */
+void
+commit_shm(void)
+{
+	if (!hdr)
+		return;
+
+	__atomic_add_fetch(&hdr->generation, 1, __ATOMIC_RELEASE);
+	wake(&hdr->generation);
+}
@@ -0,0 +1,70 @@
+/* See LICENSE file for copyright and license details. */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Layout of the shared memory status table (see shm_name in slstatus.cfg),
+ * meant to be included by readers as well.
+ *
+ * The segment starts with a struct shm_header followed by nslots slots of
+ * slotsize bytes each, slot n holding the text of status number n. Every
+ * slot is a seqlock: its seq is odd while it is being written, so a reader
+ * copies the text and retries if seq was odd or changed in the meantime, see
+ * shm_read(). No system calls are needed to read.
+ *
+ * After each batch of updates the header's generation is incremented and
+ * waiters are woken with FUTEX_WAKE (Linux), so a reader can block in
+ * FUTEX_WAIT on generation instead of polling. pid is set to 0 when slstatus
+ * exits or switches to another segment; readers should then reopen the name.
+ */
+
+#define SHM_MAGIC   0x74736c73 /* "slst" */
+#define SHM_VERSION 1
+#define SHM_SLOTS   32
+
+struct shm_header {
+	uint32_t magic;      /* written last, once the header is complete */
+	uint32_t version;
+	uint32_t nslots;
+	uint32_t slotsize;   /* bytes from one slot to the next */
+	uint32_t generation; /* incremented after every batch of updates */
+	int32_t pid;         /* of the writer, 0 once it has gone */
+	uint32_t pad[10];    /* slots start on a cache line */
+};
+
+struct shm_slot {
+	uint32_t seq; /* odd while the slot is written */
+	uint32_t len; /* of text, without the terminating NUL */
+	char text[];  /* slotsize - sizeof(struct shm_slot) bytes */
+};
+
+#define SHM_SLOT(h, n) ((struct shm_slot *)((char *)(h) + \
+                        sizeof(struct shm_header) + (size_t)(n) * (h)->slotsize))
+
+/* Copies the text of slot n to str, returns its length or -1 if too long */
+static inline int
+shm_read(struct shm_header *h, unsigned int n, char *str, size_t size)
+{
+	struct shm_slot *s = SHM_SLOT(h, n);
+	uint32_t seq, len;
+
+	do {
+		while ((seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE)) & 1)
+			;
+		len = __atomic_load_n(&s->len, __ATOMIC_RELAXED);
+		if (len < size)
+			memcpy(str, s->text, len);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) != seq);
+
+	if (len >= size)
+		return -1;
+	str[len] = '\0';
+
+	return len;
+}
+
+int attach_shm(const char *name, size_t textlen);
+void set_shm_status(const char *status_no, const char *status);
+void commit_shm(void);
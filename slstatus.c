@@ -1,19 +1,24 @@
 /* See LICENSE file for copyright and license details. */
 #include <errno.h>
+#include <limits.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 #include <sys/wait.h>
 
 #include "arg.h"
+#include "dusk.h"
+#include "registry.h"
+#include "shm.h"
 #include "slstatus.h"
 #include "util.h"
 
-typedef const char* (*ArgFunc)(const char *);
 typedef struct arg arg;
 
 struct arg {
@@ -22,62 +27,348 @@ struct arg {
 	char *args;
 	char *status_no;
 	unsigned int update_interval;
+	double min_delta;
+};
+
+#define STATS_SAMPLES 128
+
+struct stats {
+	unsigned long calls;
+	unsigned long failures;   /* the function returned NULL */
+	unsigned long pushes;
+	unsigned long unchanged;  /* same status as last pushed */
+	unsigned long suppressed; /* held back by min_delta */
+	/* the below are only collected with statistics enabled */
+	uint64_t cpu_ns;
+	uint64_t max_ns;
+	uint64_t wall_ns[STATS_SAMPLES]; /* ring of the most recent calls */
+	unsigned int nsamples;
+};
+
+/* A configured module along with its runtime state */
+struct module {
+	const char *(*func)(const char *);
+	char *fmt;
+	char *args;
+	char *status_no;
+	unsigned int update_interval;
+	double min_delta;
+
+	struct format format; /* fmt compiled */
+
+	/* what was last pushed for this module */
+	char *last;
+	double lastnum;
+	int lastnumset;
+
+	int due; /* evaluate on the next tick regardless of the interval */
+	int watched; /* evaluated when a watched fd is ready, not on the interval */
+	int truncated; /* output was cut off at maximum_length, warned once */
+
+	struct stats stats;
 };
 
 char buf[1024];
+unsigned int tick;
 static volatile sig_atomic_t done;
+static volatile sig_atomic_t pushall;
+static volatile sig_atomic_t reload;
+static volatile sig_atomic_t dumpstats;
+static int sflag, jflag;
+
+/* A display that statuses are sent to */
+struct target {
+	char *display;   /* NULL for the DISPLAY slstatus was started with */
+	char **map;      /* source and destination status_no pairs */
+	size_t nmap;     /* number of pairs, 0 to send every status as is */
+	int lock_fd;     /* -1 if not served by this instance */
+	char lock_file[100];
+};
+
+/* Status updates collected during a tick, at most one per status_no */
+struct update {
+	char *status_no;
+	char *text;
+};
+
+static struct update *updates;
+static size_t nupdates, updatessize;
+
+/* Modules are rendered into this, maximum_length bytes */
+static char *statusbuf;
+static size_t statussize;
 
 #include "config.h"
 #include "conf.c"
 
+/* Sizes the render buffer to maximum_length, keeping the old one on failure */
+static void
+sizestatus(void)
+{
+	size_t size = maximum_status_length > 0 ? maximum_status_length : MAXLEN;
+	char *p;
+
+	if (size == statussize)
+		return;
+	if (!(p = realloc(statusbuf, size))) {
+		if (!statusbuf)
+			die("realloc:");
+		warn("realloc:");
+		return;
+	}
+	statusbuf = p;
+	statussize = size;
+}
+
 static void
 terminate(const int signo)
 {
-	if (signo != SIGUSR1)
+	if (signo == SIGUSR1)
+		pushall = 1;
+	else if (signo == SIGHUP)
+		reload = 1;
+	else if (signo == SIGUSR2)
+		dumpstats = 1;
+	else
 		done = 1;
 }
 
 static void
-difftimespec(struct timespec *res, struct timespec *a, struct timespec *b)
+printjsonstr(FILE *fp, const char *str)
 {
-	res->tv_sec = a->tv_sec - b->tv_sec - (a->tv_nsec < b->tv_nsec);
-	res->tv_nsec = a->tv_nsec - b->tv_nsec + (a->tv_nsec < b->tv_nsec) * 1E9;
+	if (!str) {
+		fputs("null", fp);
+		return;
+	}
+
+	fputc('"', fp);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fprintf(fp, "\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			fprintf(fp, "\\u%04x", *str);
+		else
+			fputc(*str, fp);
+	}
+	fputc('"', fp);
 }
 
+/* Writes the queued updates to stdout as one record per line */
 static void
-usage(void)
+streamstatus(void)
 {
-	die("usage: %s [-s] [-1]", argv0);
+	struct timespec now;
+	const char *p;
+	size_t i;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	for (i = 0; i < nupdates; i++) {
+		if (jflag) {
+			fputs("{\"status_no\":", stdout);
+			printjsonstr(stdout, updates[i].status_no);
+			fputs(",\"value\":", stdout);
+			printjsonstr(stdout, updates[i].text);
+			printf(",\"timestamp\":%lld.%03ld}\n",
+			       (long long)now.tv_sec, now.tv_nsec / 1000000);
+		} else {
+			fputs(updates[i].status_no, stdout);
+			putchar('\t');
+			/* keep one record per line */
+			for (p = updates[i].text; *p; p++)
+				putchar(*p == '\n' ? ' ' : *p);
+			putchar('\n');
+		}
+	}
+
+	/* stdout is fully buffered, so this is a single write */
+	if (fflush(stdout) == EOF || ferror(stdout))
+		die("fflush:");
 }
 
-int
-main(int argc, char *argv[])
+static pid_t
+spawn(const char **argv, const char *display)
 {
-	struct sigaction act;
-	struct timespec start, current, diff, intspec, snooze;
-	int i;
-	int wait_status;
-	unsigned int loop_count = 0;
+	pid_t pid;
+
+	if ((pid = fork()) == 0) {
+		setsid();
+		if (display)
+			setenv("DISPLAY", display, 1);
+		execvp(argv[0], (char **)argv);
+		die("Error: execvp '%s' failed:", argv[0]);
+	}
+	if (pid < 0)
+		warn("fork:");
 
-	load_config();
+	return pid;
+}
 
-	char status[maximum_status_length];
-	char status_no[3] = {0};
-	const char *res;
+/* Queues a status update, replacing an earlier one for the same status */
+static void
+setstatus(const char *status_no, const char *status)
+{
+	struct update *u;
+	char *text;
+	size_t i;
+
+	if (!(text = strdup(status))) {
+		warn("strdup:");
+		return;
+	}
+
+	for (i = 0; i < nupdates; i++) {
+		if (!strcmp(updates[i].status_no, status_no)) {
+			free(updates[i].text);
+			updates[i].text = text;
+			return;
+		}
+	}
 
-	/* The external command to run to update individual statuses. */
-	const char *extcmd[] = { "duskc", "--ignore-reply", "run_command", "setstatus", status_no, status, NULL };
+	if (nupdates == updatessize) {
+		if (!(u = realloc(updates, (updatessize + 16) * sizeof(*u)))) {
+			warn("realloc:");
+			free(text);
+			return;
+		}
+		updates = u;
+		updatessize += 16;
+	}
+	if (!(updates[nupdates].status_no = strdup(status_no))) {
+		warn("strdup:");
+		free(text);
+		return;
+	}
+	updates[nupdates++].text = text;
+}
 
-	/* Get the bar height and store it in an environment variable.
-	 * The run command will return NULL if dusk is not running. */
-	const char *bar_height = run_command("duskc get_bar_height");
-	if (bar_height)
-		setenv("BAR_HEIGHT", bar_height, 1);
+/* Returns what status_no is called on target t, NULL if it is not sent there */
+static const char *
+mapstatus(const struct target *t, const char *status_no)
+{
+	size_t i;
+
+	if (!t->nmap)
+		return status_no;
+	for (i = 0; i < t->nmap; i++)
+		if (!strcmp(t->map[2 * i], status_no))
+			return t->map[2 * i + 1];
 
-	/* Create a lock file that prevents multiple instances of this
-	 * program to be running for the same user on the same display. */
-	char lock_file[100] = {0};
-	snprintf(lock_file, sizeof lock_file - 1, "/tmp/.%s.slstatus.%s.lock", getenv("USER"), getenv("DISPLAY"));
+	return NULL;
+}
+
+/* Starts sending the queued updates to target t, adding the processes run
+ * to pids and returning how many there were */
+static size_t
+sendstatus(const struct target *t, pid_t *pids)
+{
+	const char *extcmd[] = { "duskc", "--ignore-reply", "run_command", "setstatus", NULL, NULL, NULL };
+	const char **argv;
+	const char *no;
+	char *script;
+	size_t i, n = 0, args = 4;
+	pid_t pid;
+
+	if (batch_command) {
+		/* one process gets all pairs: batch_command no text [no text ...] */
+		argv = calloc(2 * nupdates + 5, sizeof(*argv));
+		script = malloc(strlen(batch_command) + sizeof("exec  \"$@\""));
+		if (argv && script) {
+			sprintf(script, "exec %s \"$@\"", batch_command);
+			argv[0] = "/bin/sh";
+			argv[1] = "-c";
+			argv[2] = script;
+			argv[3] = progname;
+			for (i = 0; i < nupdates; i++) {
+				if (!(no = mapstatus(t, updates[i].status_no)))
+					continue;
+				argv[args++] = no;
+				argv[args++] = updates[i].text;
+			}
+			if (args > 4 && (pid = spawn(argv, t->display)) > 0)
+				pids[n++] = pid;
+		} else {
+			warn("malloc:");
+		}
+		free(argv);
+		free(script);
+	} else {
+		/* dusk takes one status per call, run them side by side */
+		for (i = 0; i < nupdates; i++) {
+			if (!(extcmd[4] = mapstatus(t, updates[i].status_no)))
+				continue;
+			extcmd[5] = updates[i].text;
+			if ((pid = spawn(extcmd, t->display)) > 0)
+				pids[n++] = pid;
+		}
+	}
+
+	return n;
+}
+
+/* Sends the status updates queued during this tick */
+static void
+flushstatus(void)
+{
+	size_t i, n = 0;
+	pid_t *pids = NULL;
+	int j;
+
+	if (!nupdates)
+		return;
+
+	for (i = 0; i < nupdates; i++)
+		set_shm_status(updates[i].status_no, updates[i].text);
+	commit_shm();
+
+	if (sflag) {
+		streamstatus();
+	} else if (!(pids = calloc(num_targets * nupdates, sizeof(*pids)))) {
+		warn("calloc:");
+	} else {
+		for (j = 0; j < num_targets; j++)
+			if (targets[j].lock_fd >= 0)
+				n += sendstatus(&targets[j], pids + n);
+	}
+
+	/* only reap our own, the dusk subscription is a child as well */
+	for (i = 0; i < n; i++)
+		while (waitpid(pids[i], NULL, 0) < 0 && errno == EINTR)
+			;
+	free(pids);
+
+	for (i = 0; i < nupdates; i++) {
+		free(updates[i].status_no);
+		free(updates[i].text);
+	}
+	nupdates = 0;
+}
+
+static int
+samestr(const char *a, const char *b)
+{
+	return a == b || (a && b && !strcmp(a, b));
+}
+
+static int
+samemap(const struct target *a, const struct target *b)
+{
+	size_t i;
+
+	if (a->nmap != b->nmap)
+		return 0;
+	for (i = 0; i < 2 * a->nmap; i++)
+		if (strcmp(a->map[i], b->map[i]))
+			return 0;
+
+	return 1;
+}
+
+/* Takes the lock that prevents multiple instances of this program from
+ * serving the same user on the same display. */
+static int
+lock_target(struct target *t)
+{
+	const char *display = t->display ? t->display : getenv("DISPLAY");
 	struct flock fl = {
 		.l_type = F_WRLCK,
 		.l_whence = SEEK_SET,
@@ -85,22 +376,393 @@ main(int argc, char *argv[])
 		.l_len = 0
 	};
 
-	int lock_fd = open(lock_file, O_CREAT | O_RDWR, 0644);
-	if (lock_fd == -1) {
-		fprintf(stderr, "Error: Failed to open lock file %s: %s\n", lock_file, strerror(errno));
-		exit(1);
+	snprintf(t->lock_file, sizeof(t->lock_file) - 1, "/tmp/.%s.slstatus.%s.lock", getenv("USER"), display);
+
+	t->lock_fd = open(t->lock_file, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+	if (t->lock_fd == -1) {
+		fprintf(stderr, "Error: Failed to open lock file %s: %s\n", t->lock_file, strerror(errno));
+		return -1;
 	}
 
 	/* Try to acquire a lock on the file */
-	if (fcntl(lock_fd, F_SETLK, &fl) == -1) {
-		fprintf(stderr, "Error: Another instance of the program is already running\n");
-		exit(1);
+	if (fcntl(t->lock_fd, F_SETLK, &fl) == -1) {
+		fprintf(stderr, "Error: Another instance of the program is already running on display %s\n", display);
+		close(t->lock_fd);
+		t->lock_fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+unlock_target(struct target *t)
+{
+	struct flock fl = {
+		.l_type = F_UNLCK,
+		.l_whence = SEEK_SET,
+		.l_start = 0,
+		.l_len = 0
+	};
+
+	if (t->lock_fd < 0)
+		return;
+
+	/* Release the lock on the file */
+	fcntl(t->lock_fd, F_SETLK, &fl);
+
+	/* Close the lock file when the program exits */
+	close(t->lock_fd);
+	unlink(t->lock_file);
+	t->lock_fd = -1;
+}
+
+/* Re-reads the config, keeping what was last pushed for modules that did
+ * not change so that they are only pushed again once their value does.
+ * New or changed modules are evaluated on the next tick and statuses that
+ * are no longer used by any module are cleared. */
+static void
+reload_config(void)
+{
+	struct module *old = modules, *m, *o;
+	struct target *oldtargets = targets, *t, *ot;
+	int nold = num_modules, noldtargets = num_targets, i, j, used, resend = 0;
+
+	modules = NULL;
+	num_modules = 0;
+	targets = NULL;
+	num_targets = 0;
+
+	if (!load_config()) {
+		fprintf(stderr, "Warning: keeping the previous configuration\n");
+		free_modules(modules, num_modules);
+		free_targets(targets, num_targets);
+		modules = old;
+		num_modules = nold;
+		targets = oldtargets;
+		num_targets = noldtargets;
+		return;
+	}
+
+	/* keep the locks of displays that are still served */
+	for (i = 0; i < num_targets; i++) {
+		t = &targets[i];
+		for (j = 0; j < noldtargets; j++) {
+			ot = &oldtargets[j];
+			if (ot->lock_fd < 0 || !samestr(ot->display, t->display))
+				continue;
+			t->lock_fd = ot->lock_fd;
+			memcpy(t->lock_file, ot->lock_file, sizeof(t->lock_file));
+			ot->lock_fd = -1;
+			resend |= !samemap(ot, t);
+			break;
+		}
+		if (j == noldtargets && !sflag)
+			resend |= lock_target(t) == 0;
+	}
+	for (j = 0; j < noldtargets; j++)
+		unlock_target(&oldtargets[j]);
+	free_targets(oldtargets, noldtargets);
+
+	for (i = 0; i < num_modules; i++) {
+		m = &modules[i];
+		m->due = 1;
+		for (j = 0; j < nold; j++) {
+			o = &old[j];
+			if (!o->func || o->func != m->func || !samestr(o->args, m->args) ||
+			    !samestr(o->fmt, m->fmt) || !samestr(o->status_no, m->status_no))
+				continue;
+
+			m->last = o->last;
+			m->lastnum = o->lastnum;
+			m->lastnumset = o->lastnumset;
+			m->due = o->due;
+			m->watched = o->watched;
+			m->stats = o->stats;
+			rewatch(o, m);
+			o->last = NULL;
+			o->func = NULL;
+			break;
+		}
+		/* SIGHUP is what updates values that do not change on their own */
+		if (m->update_interval == ONCE)
+			m->due = 1;
+	}
+
+	for (j = 0; j < nold; j++) {
+		o = &old[j];
+		if (!o->func || !o->last || !o->status_no)
+			continue;
+		for (i = 0, used = 0; i < num_modules && !used; i++)
+			used = samestr(modules[i].status_no, o->status_no);
+		if (!used)
+			setstatus(o->status_no, "");
+	}
+
+	/* displays that were added or mapped differently need every status */
+	for (i = 0; resend && i < num_modules; i++)
+		if (modules[i].last && modules[i].status_no)
+			setstatus(modules[i].status_no, modules[i].last);
+
+	/* removed modules are not woken up anymore */
+	for (j = 0; j < nold; j++)
+		unwatch(&old[j]);
+	free_modules(old, nold);
+
+	if (!sflag) {
+		refresh_queries(queries, num_queries);
+		subscribe_events(dusk_events);
+	}
+
+	/* a new segment starts out empty, fill it with what dusk shows */
+	sizestatus();
+	attach_shm(shm_name, maximum_status_length);
+	for (i = 0; i < num_modules; i++)
+		if (modules[i].last && modules[i].status_no)
+			set_shm_status(modules[i].status_no, modules[i].last);
+	commit_shm();
+}
+
+static void
+difftimespec(struct timespec *res, struct timespec *a, struct timespec *b)
+{
+	res->tv_sec = a->tv_sec - b->tv_sec - (a->tv_nsec < b->tv_nsec);
+	res->tv_nsec = a->tv_nsec - b->tv_nsec + (a->tv_nsec < b->tv_nsec) * 1E9;
+}
+
+static int
+before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec ||
+	       (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void
+addms(struct timespec *ts, unsigned long long ms)
+{
+	ts->tv_sec += ms / 1000 + (ts->tv_nsec + (ms % 1000) * 1000000) / 1000000000;
+	ts->tv_nsec = (ts->tv_nsec + (ms % 1000) * 1000000) % 1000000000;
+}
+
+/*
+ * Sleeps until the next interval tick on which a module is due, a watched fd
+ * becomes ready or a signal arrives. Ticks on which no module would be
+ * evaluated are skipped, so nothing wakes up slstatus for them.
+ */
+static void
+waitdue(struct timespec *next, unsigned int *loop_count)
+{
+	static struct pollfd *pfds;
+	static size_t pfdssize;
+	struct pollfd *p;
+	struct timespec now, diff;
+	unsigned int skip = UINT_MAX, d;
+	int i, timeout = -1;
+	size_t j;
+
+	for (i = 0; i < num_modules; i++) {
+		if (modules[i].watched || modules[i].update_interval == ONCE)
+			continue;
+		d = (modules[i].update_interval - *loop_count % modules[i].update_interval) %
+		    modules[i].update_interval;
+		if (d < skip)
+			skip = d;
+	}
+	if (skip != UINT_MAX) {
+		*loop_count += skip;
+		addms(next, (unsigned long long)skip * interval);
+		if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+			die("clock_gettime:");
+		difftimespec(&diff, next, &now);
+		if (diff.tv_sec < 0)
+			timeout = 0;
+		else if (diff.tv_sec < INT_MAX / 1000 - 1)
+			timeout = diff.tv_sec * 1000 + (diff.tv_nsec + 999999) / 1000000;
+		else
+			timeout = INT_MAX;
 	}
 
+	if (nwatches > pfdssize) {
+		if (!(p = realloc(pfds, nwatches * sizeof(*p))))
+			die("realloc:");
+		pfds = p;
+		pfdssize = nwatches;
+	}
+	for (j = 0; j < nwatches; j++) {
+		pfds[j].fd = watches[j].fd;
+		pfds[j].events = watches[j].events;
+	}
+
+	if (poll(pfds, nwatches, timeout) < 0) {
+		if (errno != EINTR)
+			die("poll:");
+		return;
+	}
+
+	for (j = 0; j < nwatches; j++)
+		if (pfds[j].revents && watches[j].owner)
+			((struct module *)watches[j].owner)->due = 1;
+}
+
+static uint64_t
+nsecs(clockid_t clock)
+{
+	struct timespec ts;
+
+	if (clock_gettime(clock, &ts) < 0)
+		return 0;
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Runs a module's function, timing it if statistics are enabled. The cpu
+ * time is that of the whole process so that work done on behalf of the
+ * module in other threads (e.g. statvfs) is included. */
+static const char *
+callmodule(struct module *m)
+{
+	const char *res;
+	uint64_t wall = 0, cpu = 0;
+
+	if (statistics) {
+		wall = nsecs(CLOCK_MONOTONIC);
+		cpu = nsecs(CLOCK_PROCESS_CPUTIME_ID);
+	}
+
+	res = m->func(m->args);
+
+	m->stats.calls++;
+	if (!res)
+		m->stats.failures++;
+
+	if (statistics) {
+		wall = nsecs(CLOCK_MONOTONIC) - wall;
+		m->stats.cpu_ns += nsecs(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+		m->stats.wall_ns[m->stats.nsamples++ % STATS_SAMPLES] = wall;
+		if (wall > m->stats.max_ns)
+			m->stats.max_ns = wall;
+	}
+
+	return res;
+}
+
+static int
+cmpu64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Writes one JSON object per module, either to the statistics file (which
+ * is replaced) or to stderr. Percentiles are over the most recent calls. */
+static void
+dump_stats(void)
+{
+	FILE *fp = stderr;
+	struct stats *st;
+	uint64_t sorted[STATS_SAMPLES];
+	unsigned int n;
+	int i;
+
+	if (statistics_file && !(fp = fopen(statistics_file, "w"))) {
+		warn("fopen '%s':", statistics_file);
+		return;
+	}
+
+	for (i = 0; i < num_modules; i++) {
+		st = &modules[i].stats;
+		n = st->nsamples < STATS_SAMPLES ? st->nsamples : STATS_SAMPLES;
+		memcpy(sorted, st->wall_ns, n * sizeof(*sorted));
+		qsort(sorted, n, sizeof(*sorted), cmpu64);
+
+		fprintf(fp, "{\"module\":%d,\"function\":", i);
+		printjsonstr(fp, function_name(modules[i].func));
+		fputs(",\"argument\":", fp);
+		printjsonstr(fp, modules[i].args);
+		fputs(",\"status_no\":", fp);
+		printjsonstr(fp, modules[i].status_no);
+		fprintf(fp, ",\"calls\":%lu,\"failures\":%lu,\"pushes\":%lu,"
+		        "\"unchanged\":%lu,\"suppressed\":%lu",
+		        st->calls, st->failures, st->pushes, st->unchanged,
+		        st->suppressed);
+		if (n)
+			fprintf(fp, ",\"wall_ns\":{\"p50\":%ju,\"p99\":%ju,\"max\":%ju},"
+			        "\"cpu_ns\":%ju",
+			        (uintmax_t)sorted[n / 2], (uintmax_t)sorted[n * 99 / 100],
+			        (uintmax_t)st->max_ns, (uintmax_t)st->cpu_ns);
+		fputs("}\n", fp);
+	}
+
+	if (fp == stderr)
+		fflush(fp);
+	else if (fclose(fp) < 0)
+		warn("fclose '%s':", statistics_file);
+}
+
+/* Decides whether a freshly formatted status is worth sending to dusk.
+ * Unchanged statuses are never pushed. Numeric modules with a min_delta are
+ * held back until the value moves at least that far from the last value that
+ * was actually pushed, which gives hysteresis rather than a plain rate limit.
+ * Anything that is not numeric (including the unknown string) always goes
+ * through so that real events are not hidden. */
+static int
+shouldpush(struct module *m, const char *status, int hasnum)
+{
+	double delta;
+
+	if (!m->last)
+		return 1;
+	if (!strcmp(m->last, status)) {
+		m->stats.unchanged++;
+		return 0;
+	}
+	if (m->min_delta <= 0 || !hasnum || !m->lastnumset)
+		return 1;
+
+	delta = numval - m->lastnum;
+	if (delta < 0)
+		delta = -delta;
+
+	if (delta < m->min_delta) {
+		m->stats.suppressed++;
+		return 0;
+	}
+
+	return 1;
+}
+
+static void
+usage(void)
+{
+	die("usage: %s [-s] [-j] [-1] [-l]", argv0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct sigaction act;
+	struct timespec current, next;
+	int i, force, hasnum, locked;
+	unsigned int loop_count = 0;
+
+	/* --list-modules is spelled out for scripts, -l for the rest of us */
+	if (argc > 1 && !strcmp(argv[1], "--list-modules"))
+		argv[1] = "-l";
+
 	ARGBEGIN {
+	case 'l':
+		list_functions();
+		return 0;
 	case '1':
 		done = 1;
 		/* FALLTHROUGH */
+	case 's':
+		sflag = 1;
+		break;
+	case 'j':
+		sflag = jflag = 1;
+		break;
 	default:
 		usage();
 	} ARGEND
@@ -108,65 +770,127 @@ main(int argc, char *argv[])
 	if (argc)
 		usage();
 
+	load_config();
+	sizestatus();
+	attach_shm(shm_name, maximum_status_length);
+
+	const char *res;
+
+	/* Streaming does not involve dusk, so any number may run at once */
+	if (sflag) {
+		/* records are collected and written once per tick */
+		setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+	} else {
+		/* Export dusk state such as BAR_HEIGHT for scripts to use */
+		refresh_queries(queries, num_queries);
+		subscribe_events(dusk_events);
+
+		/* Displays served by another instance are left to it */
+		for (i = 0, locked = 0; i < num_targets; i++)
+			locked += lock_target(&targets[i]) == 0;
+		if (!locked)
+			exit(1);
+	}
+
 	memset(&act, 0, sizeof(act));
 	act.sa_handler = terminate;
 	sigaction(SIGINT,  &act, NULL);
 	sigaction(SIGTERM, &act, NULL);
 	act.sa_flags |= SA_RESTART;
+	sigaction(SIGHUP,  &act, NULL);
 	sigaction(SIGUSR1, &act, NULL);
+	sigaction(SIGUSR2, &act, NULL);
+
+	if (clock_gettime(CLOCK_MONOTONIC, &next) < 0)
+		die("clock_gettime:");
 
 	do {
-		if (clock_gettime(CLOCK_MONOTONIC, &start) < 0)
-			die("clock_gettime:");
+		/* lets components share one sample of a source between modules */
+		++tick;
 
-		for (i = 0; i < num_modules; i++) {
-			if (loop_count % modules[i].update_interval)
-				continue;
+		if (reload) {
+			reload = 0;
+			reload_config();
+		}
 
-			status[0] = '\0';
-			if (!(res = modules[i].func(modules[i].args)))
-				res = (unknown_string ? unknown_string : unknown_str);
+		if (dumpstats) {
+			dumpstats = 0;
+			dump_stats();
+		}
 
-			if (esnprintf(status, sizeof(status), modules[i].fmt, res) < 0)
-				break;
+		if (pending_events())
+			refresh_queries(queries, num_queries);
 
-			esnprintf(status_no, sizeof(status_no), modules[i].status_no);
+		/* SIGUSR1 forces every status to be re-evaluated and pushed */
+		force = pushall;
+		pushall = 0;
 
-			if (fork() == 0) {
-				setsid();
-				close(lock_fd);
-				execvp(extcmd[0], (char **)extcmd);
-				die("Error: execvp '%s' failed:", extcmd[0]);
+		/* modules that watch nothing are evaluated on their interval */
+		if (clock_gettime(CLOCK_MONOTONIC, &current) < 0)
+			die("clock_gettime:");
+		if (!before(&current, &next)) {
+			for (i = 0; i < num_modules; i++) {
+				if (modules[i].watched)
+					continue;
+				if (modules[i].update_interval == ONCE ? loop_count == 0 :
+				    loop_count % modules[i].update_interval == 0)
+					modules[i].due = 1;
+			}
+			++loop_count;
+			addms(&next, interval);
+			if (!before(&current, &next)) {
+				/* fell behind, carry on from now instead of catching up */
+				next = current;
+				addms(&next, interval);
 			}
-
-			wait(&wait_status);
 		}
 
-		++loop_count;
+		for (i = 0; i < num_modules; i++) {
+			if (!force && !modules[i].due)
+				continue;
+			modules[i].due = 0;
+
+			/* the module registers what it wants watched again */
+			unwatch(&modules[i]);
+			watchowner = &modules[i];
+			statusbuf[0] = '\0';
+			numset = 0;
+			res = callmodule(&modules[i]);
+			watchowner = NULL;
+			modules[i].watched = watched(&modules[i]);
+			if (!res)
+				res = (unknown_string ? unknown_string : unknown_str);
+			hasnum = numset && res != unknown_string && res != unknown_str;
+
+			/* too long for maximum_length, what fits is shown */
+			if (render_format(&modules[i].format, res, statusbuf, statussize) < 0 &&
+			    !modules[i].truncated++)
+				warn("module %d: Output truncated to maximum_length", i + 1);
 
-		if (!done) {
-			if (clock_gettime(CLOCK_MONOTONIC, &current) < 0)
-				die("clock_gettime:");
-			difftimespec(&diff, &current, &start);
+			if (!force && !shouldpush(&modules[i], statusbuf, hasnum))
+				continue;
 
-			intspec.tv_sec = interval / 1000;
-			intspec.tv_nsec = (interval % 1000) * 1E6;
-			difftimespec(&snooze, &intspec, &diff);
+			free(modules[i].last);
+			modules[i].last = strdup(statusbuf);
+			modules[i].lastnum = numval;
+			modules[i].lastnumset = hasnum;
+			modules[i].stats.pushes++;
 
-			if (snooze.tv_sec >= 0 && nanosleep(&snooze, NULL) < 0 && errno != EINTR)
-				die("nanosleep:");
+			if (modules[i].status_no)
+				setstatus(modules[i].status_no, statusbuf);
 		}
+		flushstatus();
+
+		if (!done)
+			waitdue(&next, &loop_count);
 	} while (!done);
 
+	attach_shm(NULL, 0);
+	subscribe_events(NULL);
+	for (i = 0; i < num_targets; i++)
+		unlock_target(&targets[i]);
 	cleanup_config();
-
-	/* Release the lock on the file */
-	fl.l_type = F_UNLCK;
-	fcntl(lock_fd, F_SETLK, &fl);
-
-	/* Close the lock file when the program exits */
-	close(lock_fd);
-	unlink(lock_file);
+	free(statusbuf);
 
 	return 0;
 }
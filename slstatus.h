@@ -13,12 +13,20 @@ const char *battery_state(const char *);
 /* cat */
 const char *cat(const char *path);
 
+/* cgroup */
+const char *cg_cpu_perc(const char *cgroup);
+const char *cg_mem_free(const char *cgroup);
+const char *cg_mem_max(const char *cgroup);
+const char *cg_mem_perc(const char *cgroup);
+const char *cg_mem_used(const char *cgroup);
+
 /* cpu */
-const char *cpu_freq(const char *unused);
+const char *cpu_freq(const char *cpu);
 const char *cpu_perc(const char *unused);
 
 /* datetime */
 const char *datetime(const char *fmt);
+const char *datetime_tz(const char *arg);
 
 /* disk */
 const char *disk_free(const char *path);
@@ -33,9 +41,9 @@ const char *entropy(const char *unused);
 const char *hostname(const char *unused);
 
 /* iocheck */
-const char *io_in(const char *unused);
-const char *io_out(const char *unused);
-const char *io_perc(const char *unused);
+const char *io_in(const char *dev);
+const char *io_out(const char *dev);
+const char *io_perc(const char *dev);
 
 /* ip */
 const char *ipv4(const char *interface);
@@ -63,6 +71,11 @@ const char *netspeed_tx(const char *interface);
 /* num_files */
 const char *num_files(const char *path);
 
+/* psi */
+const char *psi_cpu(const char *arg);
+const char *psi_io(const char *arg);
+const char *psi_mem(const char *arg);
+
 /* ram */
 const char *ram_free(const char *unused);
 const char *ram_perc(const char *unused);
@@ -81,9 +94,25 @@ const char *swap_perc(const char *unused);
 const char *swap_total(const char *unused);
 const char *swap_used(const char *unused);
 
+/* sysinfo */
+struct sysinfo;
+const struct sysinfo *sysinfo_tick(void); /* Linux, shared by uptime and load_avg */
+const char *procs(const char *unused);
+const char *si_ram_free(const char *unused);
+const char *si_ram_perc(const char *unused);
+const char *si_ram_total(const char *unused);
+const char *si_ram_used(const char *unused);
+const char *si_swap_free(const char *unused);
+const char *si_swap_perc(const char *unused);
+const char *si_swap_total(const char *unused);
+const char *si_swap_used(const char *unused);
+
 /* temperature */
 const char *temp(const char *);
 
+/* top_proc */
+const char *top_proc(const char *arg);
+
 /* uptime */
 const char *uptime(const char *unused);
 
@@ -98,3 +127,6 @@ const char *vol_perc(const char *card);
 /* wifi */
 const char *wifi_essid(const char *interface);
 const char *wifi_perc(const char *interface);
+const char *wifi_rx_bitrate(const char *interface);
+const char *wifi_signal(const char *interface);
+const char *wifi_tx_bitrate(const char *interface);
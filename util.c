@@ -1,5 +1,7 @@
 /* See LICENSE file for copyright and license details. */
+#include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -10,6 +12,26 @@
 
 char *argv0;
 
+/* The numeric value behind the string last returned by a component, if any.
+ * This is what push suppression (min_delta) compares against. */
+double numval;
+int numset;
+
+/* Directory that /proc and /sys paths are resolved under instead of /, so
+ * the components can be run against a recorded fixture tree. */
+char *sysroot;
+
+/* The fds the main loop waits on and the module being evaluated, which is
+ * what watchfd registers them for */
+struct watch *watches;
+size_t nwatches;
+void *watchowner;
+static size_t watchessize;
+
+/* Decimals and prefix style used by fmt_human */
+int human_precision = 1;
+int human_style = HUMAN_IEC;
+
 static void
 verr(const char *fmt, va_list ap)
 {
@@ -89,36 +111,308 @@ bprintf(const char *fmt, ...)
 	return (ret < 0) ? NULL : buf;
 }
 
+/* Writes num in decimal so that it ends right before end, returns the start */
+static char *
+utoa(char *end, uintmax_t num)
+{
+	do {
+		*--end = '0' + num % 10;
+		num /= 10;
+	} while (num);
+
+	return end;
+}
+
+/*
+ * The result is built backwards from the end of buf, so the returned pointer
+ * generally does not point at the start of buf.
+ */
 const char *
 fmt_human(uintmax_t num, int base)
 {
-	double scaled;
-	size_t i, prefixlen;
+	static const uintmax_t pow10[] = { 1, 10, 100, 1000 };
+	static const char *prefix_1000[] = { "", "k", "M", "G", "T", "P", "E",
+	                                     "Z", "Y" };
+	static const char *prefix_1024[] = { "", "Ki", "Mi", "Gi", "Ti", "Pi",
+	                                     "Ei", "Zi", "Yi" };
+	static const char *prefix_short[] = { "", "K", "M", "G", "T", "P", "E",
+	                                      "Z", "Y" };
+	uintmax_t div, q, r, frac, scale;
+	size_t i, len;
 	const char **prefix;
-	const char *prefix_1000[] = { "", "k", "M", "G", "T", "P", "E", "Z",
-	                              "Y" };
-	const char *prefix_1024[] = { "", "Ki", "Mi", "Gi", "Ti", "Pi", "Ei",
-	                              "Zi", "Yi" };
+	char *p;
+	int d;
 
 	switch (base) {
 	case 1000:
 		prefix = prefix_1000;
-		prefixlen = LEN(prefix_1000);
 		break;
 	case 1024:
-		prefix = prefix_1024;
-		prefixlen = LEN(prefix_1024);
+		prefix = (human_style == HUMAN_SHORT) ? prefix_short : prefix_1024;
 		break;
 	default:
 		warn("fmt_human: Invalid base");
 		return NULL;
 	}
 
-	scaled = num;
-	for (i = 0; i < prefixlen && scaled >= base; i++)
-		scaled /= base;
+	setnum(num);
+
+	/* base^8 exceeds any 64 bit value, so div cannot overflow */
+	for (i = 0, div = 1; i < LEN(prefix_1000) - 1 &&
+	     num / div >= (uintmax_t)base; i++)
+		div *= base;
+
+	/* fixed point: integer part, then the remainder rounded to precision */
+	q = num / div;
+	r = num % div;
+	scale = pow10[human_precision];
+	while (div > UINTMAX_MAX / (scale + 1)) {
+		r /= base;
+		div /= base;
+	}
+	if ((frac = (r * scale + div / 2) / div) >= scale) {
+		q++;
+		frac -= scale;
+	}
+
+	p = buf + sizeof(buf) - 1;
+	*p = '\0';
+	len = strlen(prefix[i]);
+	p -= len;
+	memcpy(p, prefix[i], len);
+	if (human_style == HUMAN_IEC)
+		*--p = ' ';
+	if (human_precision) {
+		for (d = 0; d < human_precision; d++) {
+			*--p = '0' + frac % 10;
+			frac /= 10;
+		}
+		*--p = '.';
+	}
+
+	return utoa(p, q);
+}
+
+/* Formats an integer and records it as the numeric value, see setnum */
+const char *
+fmt_int(intmax_t num)
+{
+	char *p;
+
+	setnum(num);
+
+	p = buf + sizeof(buf) - 1;
+	*p = '\0';
+	if (num < 0) {
+		p = utoa(p, -(uintmax_t)num);
+		*--p = '-';
+		return p;
+	}
+
+	return utoa(p, num);
+}
+
+void
+setnum(double num)
+{
+	numval = num;
+	numset = 1;
+}
+
+/* Whether path is dir or lies below it */
+static int
+under(const char *path, const char *dir)
+{
+	size_t len = strlen(dir);
+
+	return !strncmp(path, dir, len) && (path[len] == '/' || path[len] == '\0');
+}
+
+/*
+ * Returns path prefixed with sysroot if it lies under /proc or /sys, path
+ * itself otherwise. The result is only valid until the next call.
+ */
+const char *
+rpath(const char *path)
+{
+	static char rbuf[PATH_MAX];
+
+	if (!sysroot || !sysroot[0] || (!under(path, "/proc") &&
+	    !under(path, "/sys")))
+		return path;
+	if (esnprintf(rbuf, sizeof(rbuf), "%s%s", sysroot, path) < 0)
+		return path;
+
+	return rbuf;
+}
+
+/*
+ * Asks for the module being evaluated to be evaluated again as soon as fd is
+ * ready for events (as for poll), rather than on its update interval. The
+ * fd stays the caller's, it has to be registered again on every evaluation.
+ */
+void
+watchfd(int fd, short events)
+{
+	struct watch *w;
+	size_t i;
+
+	for (i = 0; i < nwatches; i++) {
+		if (watches[i].fd == fd && watches[i].owner == watchowner) {
+			watches[i].events = events;
+			return;
+		}
+	}
+
+	if (nwatches == watchessize) {
+		if (!(w = realloc(watches, (watchessize + 8) * sizeof(*w)))) {
+			warn("realloc:");
+			return;
+		}
+		watches = w;
+		watchessize += 8;
+	}
+	watches[nwatches].fd = fd;
+	watches[nwatches].events = events;
+	watches[nwatches++].owner = watchowner;
+}
+
+/* Stops watching fd, e.g. before closing it */
+void
+unwatchfd(int fd)
+{
+	size_t i;
+
+	for (i = 0; i < nwatches; )
+		if (watches[i].fd == fd)
+			watches[i] = watches[--nwatches];
+		else
+			i++;
+}
+
+void
+unwatch(void *owner)
+{
+	size_t i;
+
+	for (i = 0; i < nwatches; )
+		if (watches[i].owner == owner)
+			watches[i] = watches[--nwatches];
+		else
+			i++;
+}
+
+int
+watched(void *owner)
+{
+	size_t i;
+
+	for (i = 0; i < nwatches; i++)
+		if (watches[i].owner == owner)
+			return 1;
+
+	return 0;
+}
+
+void
+rewatch(void *from, void *to)
+{
+	size_t i;
+
+	for (i = 0; i < nwatches; i++)
+		if (watches[i].owner == from)
+			watches[i].owner = to;
+}
+
+/*
+ * Compiles a module format. "%s" and "{value}" are replaced with the value,
+ * "%%" is a literal percent sign and anything else is copied as is, so a
+ * format from the configuration never reaches printf.
+ */
+int
+compile_format(struct format *f, const char *fmt)
+{
+	const char *p, *lit;
+	char *q;
+	size_t len;
+	int warned = 0;
+
+	if (!fmt)
+		fmt = "%s";
+	len = strlen(fmt);
+
+	/* every slot takes at least two characters */
+	if (!(f->segs = calloc(len + 1, sizeof(*f->segs))) ||
+	    !(f->text = malloc(len + 1))) {
+		free(f->segs);
+		warn("malloc:");
+		return -1;
+	}
+	f->nsegs = 0;
+
+	for (p = fmt, lit = q = f->text; *p; ) {
+		if (!strncmp(p, "%s", 2) || !strncmp(p, "{value}", 7)) {
+			if (q > lit) {
+				f->segs[f->nsegs].str = lit;
+				f->segs[f->nsegs++].len = q - lit;
+			}
+			f->segs[f->nsegs].str = NULL;
+			f->segs[f->nsegs++].len = 0;
+			lit = q;
+			p += (*p == '%') ? 2 : 7;
+		} else if (!strncmp(p, "%%", 2)) {
+			*q++ = '%';
+			p += 2;
+		} else {
+			if (*p == '%' && isalpha((unsigned char)p[1]) && !warned++)
+				warn("format '%s': Only %%s is supported, "
+				     "copying '%%%c' as is", fmt, p[1]);
+			*q++ = *p++;
+		}
+	}
+	if (q > lit) {
+		f->segs[f->nsegs].str = lit;
+		f->segs[f->nsegs++].len = q - lit;
+	}
+
+	return 0;
+}
+
+/*
+ * Renders f with value into str. Output that does not fit is cut off at
+ * size - 1 bytes, which is still returned in str, and -1 is returned.
+ */
+int
+render_format(const struct format *f, const char *value, char *str, size_t size)
+{
+	const char *src;
+	size_t i, len, n, vlen;
+
+	vlen = strlen(value);
+	for (i = 0, n = 0; i < f->nsegs; i++) {
+		src = f->segs[i].str ? f->segs[i].str : value;
+		len = f->segs[i].str ? f->segs[i].len : vlen;
+		if (n + len >= size) {
+			memcpy(str + n, src, size - 1 - n);
+			str[size - 1] = '\0';
+			return -1;
+		}
+		memcpy(str + n, src, len);
+		n += len;
+	}
+	str[n] = '\0';
+
+	return n;
+}
 
-	return bprintf("%.1f %s", scaled, prefix[i]);
+void
+free_format(struct format *f)
+{
+	free(f->segs);
+	free(f->text);
+	f->segs = NULL;
+	f->text = NULL;
+	f->nsegs = 0;
 }
 
 int
@@ -128,6 +422,7 @@ pscanf(const char *path, const char *fmt, ...)
 	va_list ap;
 	int n;
 
+	path = rpath(path);
 	if (!(fp = fopen(path, "r"))) {
 		warn("fopen '%s':", path);
 		return -1;
@@ -2,12 +2,54 @@
 #include <stdint.h>
 
 extern char buf[1024];
+extern unsigned int tick;
+extern double numval;
+extern int numset;
+extern char *sysroot;
 
 #define LEN(x) (sizeof(x) / sizeof((x)[0]))
 #define MAX(A, B) ((A) > (B) ? (A) : (B))
 
 extern char *argv0;
 
+enum {
+	HUMAN_IEC,     /* "1.5 Ki" */
+	HUMAN_COMPACT, /* "1.5Ki" */
+	HUMAN_SHORT    /* "1.5K" */
+};
+
+/*
+ * A module format compiled into literal text and value slots. A slot has a
+ * NULL str and is filled in with the module's result when rendering.
+ */
+struct segment {
+	const char *str;
+	size_t len;
+};
+
+struct format {
+	struct segment *segs;
+	size_t nsegs;
+	char *text; /* the literal text the segments point into */
+};
+
+/*
+ * A file descriptor that makes its owner (a module, or NULL for slstatus
+ * itself) due for evaluation when it becomes ready, see watchfd.
+ */
+struct watch {
+	int fd;
+	short events;
+	void *owner;
+};
+
+extern struct watch *watches;
+extern size_t nwatches;
+extern void *watchowner;
+
+extern int human_precision;
+extern int human_style;
+
 #if HAVE_MPD
 enum {
 	NO_SCROLL,
@@ -22,6 +64,17 @@ void die(const char *, ...);
 int esnprintf(char *str, size_t size, const char *fmt, ...);
 const char *bprintf(const char *fmt, ...);
 const char *fmt_human(uintmax_t num, int base);
+const char *fmt_int(intmax_t num);
+void setnum(double num);
+void watchfd(int fd, short events);
+void unwatchfd(int fd);
+void unwatch(void *owner);
+int watched(void *owner);
+void rewatch(void *from, void *to);
+int compile_format(struct format *f, const char *fmt);
+int render_format(const struct format *f, const char *value, char *str, size_t size);
+void free_format(struct format *f);
+const char *rpath(const char *path);
 int pscanf(const char *path, const char *fmt, ...);
 size_t strlcpy(char * __restrict dst, const char * __restrict src, size_t dsize);
 size_t strlcat(char *dst, const char *src, size_t siz);